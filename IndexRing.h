@@ -0,0 +1,52 @@
+#ifndef INDEXRING_H_
+#define INDEXRING_H_
+
+#include <stdint.h>
+
+
+// Single-producer/single-consumer ring of buffer indexes, the data itself lives in the caller's array.
+// Capacity is a power of two so positions wrap with a mask, head and tail are free running counters
+// and each side only ever writes its own, published with release and read with acquire ordering.
+// This makes it safe between an ISR and the code it interrupts, or two threads on the host.
+//
+//   producer: if (!isFull()) { fill slot nextWrite(); write(); }
+//   consumer: if (!isEmpty()) { use slot nextRead(); read(); }
+
+template <uint32_t Capacity>
+class IndexRing
+{
+	static_assert(Capacity && !(Capacity & (Capacity - 1)), "IndexRing capacity must be a power of two");
+
+protected:
+	uint32_t		m_Head;		//< Number of elements written, only changed by producer.
+	uint32_t		m_Tail;		//< Number of elements read, only changed by consumer.
+
+
+public:
+	static const uint32_t mask = Capacity - 1;
+
+
+	IndexRing()																{ reset(); }
+
+
+	// only call while neither side is using the ring
+	void		reset()														{ m_Head = 0; m_Tail = 0; }
+
+	uint32_t	capacity() const											{ return Capacity; }
+	uint32_t	count() const
+		{ return __atomic_load_n(&m_Head, __ATOMIC_ACQUIRE) - __atomic_load_n(&m_Tail, __ATOMIC_ACQUIRE); }
+	bool		isEmpty() const												{ return count() == 0; }
+	bool		isFull() const												{ return count() == Capacity; }
+
+	// producer: index of next element to write, and mark it as written (ring must not be full)
+	uint32_t	nextWrite() const											{ return __atomic_load_n(&m_Head, __ATOMIC_RELAXED) & mask; }
+	void		write()
+		{ __atomic_store_n(&m_Head, __atomic_load_n(&m_Head, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE); }
+
+	// consumer: index of next element to read, and mark it as read (ring must not be empty)
+	uint32_t	nextRead() const											{ return __atomic_load_n(&m_Tail, __ATOMIC_RELAXED) & mask; }
+	void		read()
+		{ __atomic_store_n(&m_Tail, __atomic_load_n(&m_Tail, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE); }
+};
+
+#endif // INDEXRING_H_
@@ -28,6 +28,7 @@ colorCorrectionModes SmartMatrix::_ccmode = cc48;
 
 void SmartMatrix::setColorCorrection(colorCorrectionModes mode) {
     _ccmode = mode;
+    calculateColorSpreadLUT();
 }
 
 // source - somewhere on the internet (arduino forum?)
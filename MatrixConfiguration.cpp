@@ -39,6 +39,8 @@ void SmartMatrix::setRotation(rotationDegrees rotation) {
         screenConfig.localWidth = MATRIX_HEIGHT;
         screenConfig.localHeight = MATRIX_WIDTH;
     }
+
+    selectRotatedDrawing();
 }
 
 uint16_t SmartMatrix::getScreenWidth(void) const {
@@ -63,5 +65,6 @@ uint8_t SmartMatrix::backgroundBrightness = 255;
 
 void SmartMatrix::setBackgroundBrightness(uint8_t brightness) {
     backgroundBrightness = brightness;
+    calculateColorSpreadLUT();
 }
 
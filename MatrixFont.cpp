@@ -23,28 +23,26 @@
 
 #include "SmartMatrix.h"
 
-// depends on letters in font->Index table being arranged in ascending order
-// save location of last lookup to speed up repeated lookups of the same letter
-// TODO: use successive approximation to located index faster
+// constant time through the font's Lookup table, fonts without one fall back to a binary search
+// which depends on letters in font->Index table being arranged in ascending order
+// no state is kept between calls, so it's safe to use from the refresh ISR and the sketch at once
 int SmartMatrix::getBitmapFontLocation(unsigned char letter, const bitmap_font *font) {
-    static int location = 0;
+    if(font->Lookup)
+        return font->Lookup[letter];
 
-    if(location < 0)
-        location = 0;
-
-    if(font->Index[location] == letter)
-        return location;
-
-    if(font->Index[location] < letter) {
-        for (; location < font->Chars; location++) {
-            if (font->Index[location] == letter)
-                return location;
-        }
-    } else {
-        for (; location >= 0; location--) {
-            if (font->Index[location] == letter)
-                return location;
-        }
+    int low = 0;
+    int high = font->Chars - 1;
+
+    while(low <= high) {
+        int mid = (low + high) / 2;
+
+        if(font->Index[mid] == letter)
+            return mid;
+
+        if(font->Index[mid] < letter)
+            low = mid + 1;
+        else
+            high = mid - 1;
     }
 
     return -1;
@@ -16,6 +16,7 @@ typedef struct bitmap_font {
 	const unsigned char *Widths;	///< width of each character
 	const unsigned short *Index;	///< encoding to character index
 	const unsigned char *Bitmap;	///< bitmap of all characters
+	const short *Lookup;		///< character index of each 8-bit encoding, -1 if not in font (optional)
 } bitmap_font;
 
 /// @{ defines to have human readable font files
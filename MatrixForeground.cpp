@@ -35,6 +35,22 @@ static const unsigned char	foregroundRefreshBuffer = 1;
 static bool					majorForegroundChange	= false;
 bool						hasForeground			= false;
 
+// foreground mask in hardware orientation, read by the refresh code: MSB of word 0 is hardware column 0
+// with rotation0 the refresh bitmap is used directly, other rotations are transformed after each redraw
+static uint32_t				foregroundRotatedMask[MATRIX_HEIGHT][MATRIX_WIDTH / 32];
+static uint32_t				(*foregroundMask)[MATRIX_WIDTH / 32] = foregroundBitmap[foregroundRefreshBuffer];
+static rotationDegrees		foregroundMaskRotation	= rotation0;
+// scroller index for each hardware row (rotation0/180) or column (rotation90/270)
+static uint8_t				foregroundRowColors[MATRIX_HEIGHT];
+static uint8_t				foregroundColumnColors[MATRIX_WIDTH];
+static bool					foregroundColorsPerColumn = false;
+
+// local rows the foreground bitmap has room for, with rotation90/270 local rows past MATRIX_HEIGHT are transparent
+static inline int foregroundRows(int localHeight)
+{
+	return (localHeight < MATRIX_HEIGHT) ? localHeight : MATRIX_HEIGHT;
+}
+
 
 void SmartMatrix::clearForeground(void) {
     memset(foregroundBitmap[foregroundDrawBuffer], 0x00, sizeof(foregroundBitmap[0]));
@@ -142,6 +158,7 @@ void TextScroller::scrollText(const char inputtext[], int numScrolls) {
 		textLen = strlen(inputtext);
 		text.init((void *)inputtext, textLen);
 		text.write(NULL, textLen);
+		resetStrip();
 
 		setup(true);
 		scrollCounter = numScrolls;
@@ -162,6 +179,10 @@ void TextScroller::setScrollSpeed(unsigned char pixels_per_second) {
 
 void TextScroller::setScrollFont(fontChoices newFont) {
     scrollFont = matrix->fontLookup(newFont);
+
+    // strip has to be rendered again in the new font
+    resetStrip();
+    updateStrip();
 }
 
 void TextScroller::setScrollOffsetFromTop(int offset) {
@@ -185,6 +206,7 @@ void TextScroller::stopScrollText(void) {
 	{
         text.reset();
 		textLen = 0;
+		resetStrip();
 	}
 }
 
@@ -200,6 +222,8 @@ void TextScroller::setRingBuffer(uint8_t *buffer, size_t size)
 		text.init(NULL, 0);
 		ringEnabled = false;
 	}
+
+	resetStrip();
 }
 
 size_t TextScroller::appendRing(const char *_text)
@@ -216,6 +240,127 @@ size_t TextScroller::appendRing(const char *_text)
 	return text.remain();
 }
 
+// buffer for pre-rendering the text, size in 32-bit words is needed for each row of the font:
+// ((number of characters * font width) + 31) / 32, text that doesn't fit is drawn glyph by glyph instead
+void TextScroller::setStripBuffer(uint32_t *buffer, size_t size)
+{
+	stripValid = false;
+	strip = buffer;
+	stripSize = (buffer) ? size : 0;
+
+	resetStrip();
+	updateStrip();
+}
+
+void TextScroller::resetStrip(void)
+{
+	stripValid	= false;
+	stripChars	= 0;
+	stripHead	= 0;
+	stripTail	= 0;
+	stripStride	= (strip) ? stripSize / scrollFont->Height : 0;
+}
+
+// render characters added to text since the last update onto the tail of the strip
+void TextScroller::updateStrip(void)
+{
+	int capacity = stripStride * 32;
+	int k, x;
+
+	if(!stripStride || stripChars > textLen)
+		return;
+
+	if(!stripChars)
+		stripValid = true;
+
+	// textLen can be ahead of the ring buffer contents, only render what's there
+	for(; stripChars < textLen && stripChars < (int)text.size() && stripValid; stripChars++)
+	{
+		int fontLocation = matrix->getBitmapFontLocation(text[stripChars], scrollFont);
+
+		// characters without a glyph take no space, same as drawFramebuffer()
+		if(fontLocation < 0)
+			continue;
+
+		if(stripTail - stripHead + scrollFont->Width > capacity)
+		{
+			// doesn't fit, stop using the strip until the text is replaced
+			stripValid = false;
+			break;
+		}
+
+		for(k = 0; k < scrollFont->Height; k++)
+		{
+			uint32_t *row = &strip[k * stripStride];
+			uint32_t fontRow = matrix->getBitmapFontRowAtXY(fontLocation, k, scrollFont) << 24;
+
+			for(x = 0; x < scrollFont->Width; x++)
+			{
+				int column = (stripTail + x) % capacity;
+
+				if(fontRow & (0x80000000 >> x))
+					row[column >> 5] |= 0x80000000 >> (column & 31);
+				else
+					row[column >> 5] &= ~(0x80000000 >> (column & 31));
+			}
+		}
+
+		stripTail += scrollFont->Width;
+	}
+}
+
+// drop characters consumed from the front of the text
+void TextScroller::trimStrip(int chars)
+{
+	int capacity = stripStride * 32;
+
+	if(!stripValid)
+		return;
+
+	for(int i = 0; i < chars && i < stripChars; i++)
+	{
+		if(matrix->getBitmapFontLocation(text[i], scrollFont) > -1)
+			stripHead += scrollFont->Width;
+	}
+
+	stripChars = (chars < stripChars) ? stripChars - chars : 0;
+
+	// keep head inside the buffer
+	if(stripHead >= capacity)
+	{
+		stripHead -= capacity;
+		stripTail -= capacity;
+	}
+}
+
+// 32 columns of one font row starting at offset pixels into the text, columns outside of the text are clear
+uint32_t TextScroller::getStripBits(int row, int offset) const
+{
+	int capacity = stripStride * 32;
+	int columns = stripTail - stripHead;
+	uint32_t valid = 0xFFFFFFFF;
+	uint32_t bits;
+
+	if(offset >= columns || offset <= -32)
+		return 0;
+
+	if(offset < 0)
+		valid >>= -offset;
+	if(columns - offset < 32)
+		valid &= 0xFFFFFFFF << (32 - (columns - offset));
+
+	int column	= ((stripHead + offset) % capacity + capacity) % capacity;
+	int word	= column >> 5;
+	int shift	= column & 31;
+	const uint32_t *stripRow = &strip[row * stripStride];
+
+	bits = stripRow[word];
+	if(shift)
+		bits = (bits << shift) | (stripRow[(word + 1) % stripStride] >> (32 - shift));
+
+	return bits & valid;
+}
+
 bool TextScroller::getRingStatus(size_t &used, size_t &room)
 {
 	used = text.size();
@@ -275,6 +420,8 @@ void TextScroller::setup(bool start)
 			scrollMin = scrollMax = scrollPosition = 0;
 			break;
 	}
+
+	updateStrip();
 }
 
 bool TextScroller::updateScrolling()
@@ -312,6 +459,7 @@ bool TextScroller::updateScrolling()
 		int oschar = abs(scrollPosition - bounds.x0) / scrollFont->Width;
 		if(text[oschar] == ringDelimiter)
 		{
+			trimStrip(oschar +1);
 			text	-= oschar +1;
 			textLen -= oschar +1;
 
@@ -356,35 +504,73 @@ bool TextScroller::updateScrolling()
 			cbEvents(this, eScrollerEvent::Stopped);
     }
 
-    // for now, fill the bitmap fresh with each update
-    // TODO: reset only when necessary, and update just the pixels that need it
+    // the scroller moved, updateForeground() decides if it can be shifted or needs a full redraw
     resetScrolls = true;
 	return resetScrolls;
 }
 
+// mask of the columns inside x0-x1 for one 32 column word of a foreground bitmap row
+static uint32_t getBoundsMask(int word, int x0, int x1)
+{
+	int first	= x0 - word * 32;
+	int last	= x1 - word * 32;
+
+	if(first > 31 || last < 0)
+		return 0;
+
+	first	= (first < 0) ? 0 : first;
+	last	= (last > 31) ? 31 : last;
+
+	return (0xFFFFFFFF >> first) & (0xFFFFFFFF << (31 - last));
+}
+
 bool TextScroller::drawFramebuffer(size_t id)
 {
-    int j, jLimit, k, l, strideStart, strideEnd;
+    int j, jLimit, k, l, strideStart, strideEnd, rows;
     int charPosition, textPosition;
     uint8_t charY0, charY1;
-	uint32_t maskLeft	= ((~0UL) >> (bounds.x0 % 32));
-	uint32_t maskRight	= ((~0UL) << (31 - (bounds.x1 % 32)));
 
 
 	strideStart	= bounds.x0 / 32;
-//	strideEnd	= matrix->screenConfig.localWidth / 32;
-	strideEnd	= bounds.x1 / 32;
-	if(bounds.x1 % 32)
-		strideEnd += 1;
+	strideEnd	= bounds.x1 / 32 + 1;
+	if(strideEnd > MATRIX_WIDTH / 32)
+		strideEnd = MATRIX_WIDTH / 32;
 
 	hasForeground = false;
 
+	drawn = { true, scrollPosition, fontTopOffset, textLen, bounds.x0, bounds.x1, scrollFont };
+	edgeGlyph[0].valid = false;
+	edgeGlyph[1].valid = false;
+
 	// skip rows without text
+	rows = foregroundRows(SmartMatrix::screenConfig.localHeight);
 	jLimit = fontTopOffset + scrollFont->Height;
-	jLimit = (jLimit > SmartMatrix::screenConfig.localHeight) ? SmartMatrix::screenConfig.localHeight : jLimit;
+	jLimit = (jLimit > rows) ? rows : jLimit;
 	jLimit = (jLimit < 0)? 0 : jLimit;
 	j = (fontTopOffset > 0)? fontTopOffset : 0;
 
+	if(stripValid && stripChars == textLen)
+	{
+		// copy the visible window out of the pre-rendered strip
+		for(; j < jLimit; j++)
+		{
+			hasForeground = true;
+
+			for(l = strideStart; l < strideEnd; ++l)
+			{
+				uint32_t bits = getStripBits(j - fontTopOffset, l * 32 - scrollPosition) & getBoundsMask(l, bounds.x0, bounds.x1);
+
+				if(bits)
+				{
+					foregroundBitmap[foregroundRefreshBuffer][j][l] |= bits;
+					foregroundColorLines[foregroundRefreshBuffer][j] = (uint8_t)id;
+				}
+			}
+		}
+
+		return hasForeground;
+	}
+
 	for(; j < jLimit; j++)
 	{
         hasForeground = true;
@@ -404,14 +590,14 @@ bool TextScroller::drawFramebuffer(size_t id)
         // find rows within character bitmap that will be drawn (0-font->height unless text is partially off screen)
         charY0 = j - fontTopOffset;
 
-        if (SmartMatrix::screenConfig.localHeight < (fontTopOffset + scrollFont->Height))
+        if (rows < (fontTopOffset + scrollFont->Height))
 		{
-            charY1 = SmartMatrix::screenConfig.localHeight - fontTopOffset;
+            charY1 = rows - fontTopOffset;
         } else {
             charY1 = scrollFont->Height;
         }
 
-        while((textPosition < textLen) && (charPosition < bounds.x1))
+        while((textPosition < textLen) && (charPosition <= bounds.x1))
 		{
             uint32_t tempBitmask, mask2;
 			int fontLocation;
@@ -437,10 +623,7 @@ bool TextScroller::drawFramebuffer(size_t id)
 						} else
 							continue;
 
-						if(charPosition < bounds.x0)
-							mask2 &= maskLeft;
-						else if(charPosition + scrollFont->Width >= bounds.x1)
-							mask2 &= maskRight;
+						mask2 &= getBoundsMask(l, bounds.x0, bounds.x1);
 
 						foregroundBitmap[foregroundRefreshBuffer][j + k - charY0][l] |= mask2;
 					}
@@ -463,6 +646,146 @@ bool TextScroller::drawFramebuffer(size_t id)
 }
 
 
+// rows of the foreground bitmap the scroller draws into, returns false if none are on screen
+bool TextScroller::getFramebufferRows(int &y0, int &y1) const
+{
+	int rows = foregroundRows(SmartMatrix::screenConfig.localHeight);
+
+	y0 = (fontTopOffset > 0) ? fontTopOffset : 0;
+	y1 = fontTopOffset + scrollFont->Height;
+	y1 = (y1 > rows) ? rows : y1;
+
+	return y0 < y1;
+}
+
+// true if the foreground bitmap already shows the scroller as it is now
+bool TextScroller::isFramebufferCurrent(void) const
+{
+	if(!scrollCounter)
+		return !drawn.visible;
+
+	return drawn.visible && drawn.position == scrollPosition && drawn.top == fontTopOffset &&
+		drawn.textLen == textLen && drawn.x0 == bounds.x0 && drawn.x1 == bounds.x1 && drawn.font == scrollFont;
+}
+
+// true if the scroller only moved one pixel since it was drawn, so shiftFramebuffer() can be used
+bool TextScroller::canShiftFramebuffer(void) const
+{
+	return scrollCounter && drawn.visible && abs(scrollPosition - drawn.position) == 1 && drawn.top == fontTopOffset &&
+		drawn.textLen == textLen && drawn.x0 == bounds.x0 && drawn.x1 == bounds.x1 && drawn.font == scrollFont;
+}
+
+// returns the next text position from textPosition (inclusive) in direction step that has a glyph in the font
+int TextScroller::nextDrawableGlyph(int textPosition, int step)
+{
+	while(textPosition >= 0 && textPosition < textLen && matrix->getBitmapFontLocation(text[textPosition], scrollFont) < 0)
+		textPosition += step;
+
+	return textPosition;
+}
+
+// returns the font location of the glyph covering offset pixels from scrollPosition, or -1 if there's none
+// glyphs without a bitmap in the font take no space, same as drawFramebuffer(). The glyph found last at the
+// same edge is the starting point, so following a scrolling edge only looks at one or two glyphs
+int TextScroller::findEdgeGlyph(int edge, int offset)
+{
+	int position;
+
+	if(!edgeGlyph[edge].valid)
+	{
+		edgeGlyph[edge].textPosition	= nextDrawableGlyph(0, 1);
+		edgeGlyph[edge].offset			= 0;
+		edgeGlyph[edge].valid			= true;
+	}
+
+	// move forward to the glyph that ends after offset
+	while(edgeGlyph[edge].textPosition < textLen && offset >= edgeGlyph[edge].offset + scrollFont->Width)
+	{
+		edgeGlyph[edge].textPosition	= nextDrawableGlyph(edgeGlyph[edge].textPosition + 1, 1);
+		edgeGlyph[edge].offset			+= scrollFont->Width;
+	}
+
+	// or back to the glyph that starts before it
+	while(offset < edgeGlyph[edge].offset && (position = nextDrawableGlyph(edgeGlyph[edge].textPosition - 1, -1)) >= 0)
+	{
+		edgeGlyph[edge].textPosition	= position;
+		edgeGlyph[edge].offset			-= scrollFont->Width;
+	}
+
+	if(offset < edgeGlyph[edge].offset || offset >= edgeGlyph[edge].offset + scrollFont->Width ||
+		edgeGlyph[edge].textPosition >= textLen)
+		return -1;
+
+	return matrix->getBitmapFontLocation(text[edgeGlyph[edge].textPosition], scrollFont);
+}
+
+// move the scroller's rows by one pixel and draw the column exposed at the leading edge
+// only valid when canShiftFramebuffer() is true, and no other scroller draws into the same rows
+void TextScroller::shiftFramebuffer(size_t id)
+{
+	uint32_t (*bitmap)[MATRIX_WIDTH / 32] = foregroundBitmap[foregroundRefreshBuffer];
+	int step = scrollPosition - drawn.position;
+	int strideStart, strideEnd, y0, y1, j, l;
+	int edge, edgeX, fontLocation;
+	bool useStrip;
+
+	drawn.position = scrollPosition;
+
+	if(!getFramebufferRows(y0, y1))
+		return;
+
+	strideStart	= bounds.x0 / 32;
+	strideEnd	= bounds.x1 / 32 + 1;
+	if(strideEnd > MATRIX_WIDTH / 32)
+		strideEnd = MATRIX_WIDTH / 32;
+
+	// text moving left exposes a column on the right edge, moving right exposes one on the left
+	edge	= (step < 0) ? 1 : 0;
+	edgeX	= edge ? bounds.x1 : bounds.x0;
+	useStrip = stripValid && stripChars == textLen;
+	fontLocation = (useStrip) ? -1 : findEdgeGlyph(edge, edgeX - scrollPosition);
+
+	for(j = y0; j < y1; j++)
+	{
+		uint32_t *row = bitmap[j];
+
+		if(step < 0)
+		{
+			for(l = strideStart; l < strideEnd; l++)
+			{
+				uint32_t carry = (l + 1 < MATRIX_WIDTH / 32) ? (row[l + 1] >> 31) : 0;
+				row[l] = ((row[l] << 1) | carry) & getBoundsMask(l, bounds.x0, bounds.x1);
+			}
+		} else {
+			for(l = strideEnd - 1; l >= strideStart; l--)
+			{
+				uint32_t carry = (l > 0) ? (row[l - 1] << 31) : 0;
+				row[l] = ((row[l] >> 1) | carry) & getBoundsMask(l, bounds.x0, bounds.x1);
+			}
+		}
+
+		if((!useStrip && fontLocation < 0) || edgeX < 0 || edgeX >= MATRIX_WIDTH)
+			continue;
+
+		// column of the glyph at the edge
+		bool edgePixel;
+		if(useStrip)
+		{
+			edgePixel = getStripBits(j - fontTopOffset, edgeX - scrollPosition) & 0x80000000;
+		} else {
+			uint32_t fontRow = matrix->getBitmapFontRowAtXY(fontLocation, j - fontTopOffset, scrollFont) << 24;
+			edgePixel = fontRow & (0x80000000 >> (edgeX - scrollPosition - edgeGlyph[edge].offset));
+		}
+
+		if(edgePixel)
+		{
+			row[edgeX >> 5] |= 0x80000000 >> (edgeX & 31);
+			foregroundColorLines[foregroundRefreshBuffer][j] = (uint8_t)id;
+		}
+	}
+}
+
+
 // if font size or position changed since the last call, redraw the whole frame
 void SmartMatrix::redrawForeground(void)
 {
@@ -477,17 +800,118 @@ void SmartMatrix::redrawForeground(void)
 		TextScroller &scroll = scrollers[i -1];
 
 		if(!scroll.scrollCounter)
+		{
+			scroll.drawn.visible = false;
 			continue;
+		}
 
 		if(scroll.drawFramebuffer(i -1))
 			hasForeground = true;
 	}
+
+	updateForegroundMask();
+}
+
+static uint32_t reverseBits(uint32_t value) {
+	value = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+	value = ((value >> 2) & 0x33333333) | ((value & 0x33333333) << 2);
+	value = ((value >> 4) & 0x0F0F0F0F) | ((value & 0x0F0F0F0F) << 4);
+	return __builtin_bswap32(value);
+}
+
+// transform the local foreground bitmap into the hardware orientation mask used by the refresh code
+void SmartMatrix::updateForegroundMask(void)
+{
+	const uint32_t (*bitmap)[MATRIX_WIDTH / 32] = foregroundBitmap[foregroundRefreshBuffer];
+	const uint8_t *colorLines = foregroundColorLines[foregroundRefreshBuffer];
+	int hardwareX, hardwareY, localX, localY, i;
+
+	foregroundMaskRotation = SmartMatrix::screenConfig.rotation;
+
+	switch(foregroundMaskRotation)
+	{
+		case rotation0:
+		default:
+			foregroundMask = foregroundBitmap[foregroundRefreshBuffer];
+			memcpy(foregroundRowColors, colorLines, sizeof(foregroundRowColors));
+			foregroundColorsPerColumn = false;
+			return;
+
+		case rotation180:
+			// rows are flipped, and columns mirrored by reversing the order of bits and words
+			for(hardwareY = 0; hardwareY < MATRIX_HEIGHT; hardwareY++)
+			{
+				localY = (MATRIX_HEIGHT - 1) - hardwareY;
+				for(i = 0; i < MATRIX_WIDTH / 32; i++)
+					foregroundRotatedMask[hardwareY][i] = reverseBits(bitmap[localY][(MATRIX_WIDTH / 32 - 1) - i]);
+				foregroundRowColors[hardwareY] = colorLines[localY];
+			}
+			foregroundColorsPerColumn = false;
+			break;
+
+		case rotation90:
+		case rotation270:
+			// each hardware column comes from one local row
+			memset(foregroundRotatedMask, 0x00, sizeof(foregroundRotatedMask));
+			for(hardwareX = 0; hardwareX < MATRIX_WIDTH; hardwareX++)
+			{
+				localY = (foregroundMaskRotation == rotation90) ? (MATRIX_WIDTH - 1) - hardwareX : hardwareX;
+
+				// local rows beyond the bitmap are transparent
+				foregroundColumnColors[hardwareX] = 0;
+				if(localY >= MATRIX_HEIGHT)
+					continue;
+
+				// local x comes from the hardware row, so it's always in the first word
+				foregroundColumnColors[hardwareX] = colorLines[localY];
+				if(!bitmap[localY][0])
+					continue;
+
+				for(hardwareY = 0; hardwareY < MATRIX_HEIGHT; hardwareY++)
+				{
+					localX = (foregroundMaskRotation == rotation90) ? hardwareY : (MATRIX_HEIGHT - 1) - hardwareY;
+
+					if(bitmap[localY][localX >> 5] & (0x80000000 >> (localX & 31)))
+						foregroundRotatedMask[hardwareY][hardwareX >> 5] |= 0x80000000 >> (hardwareX & 31);
+				}
+			}
+			foregroundColorsPerColumn = true;
+			break;
+	}
+
+	foregroundMask = foregroundRotatedMask;
 }
 
-// called once per frame to update foreground (virtual) bitmap
-void SmartMatrix::updateForeground(void)
+// true if every scroller that changed only moved by one pixel, and no two visible scrollers share rows
+bool SmartMatrix::canShiftForeground(void)
 {
-	bool doRedraw = false;
+	int y0[MATRIX_SCROLLERS], y1[MATRIX_SCROLLERS];
+	bool visible[MATRIX_SCROLLERS];
+	size_t i, j;
+
+	for(i = 0; i < MATRIX_SCROLLERS; i++)
+	{
+		TextScroller &scroll = scrollers[i];
+
+		if(!scroll.isFramebufferCurrent() && !scroll.canShiftFramebuffer())
+			return false;
+
+		visible[i] = scroll.scrollCounter && scroll.getFramebufferRows(y0[i], y1[i]);
+
+		for(j = 0; j < i; j++)
+		{
+			if(visible[i] && visible[j] && y0[i] < y1[j] && y0[j] < y1[i])
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// called once per frame to update foreground (virtual) bitmap, returns true if it was redrawn
+bool SmartMatrix::updateForeground(void)
+{
+	bool doUpdate = false;
 
 
 	for(size_t i=MATRIX_SCROLLERS; i>0; --i)
@@ -495,54 +919,50 @@ void SmartMatrix::updateForeground(void)
 		TextScroller &scroll = scrollers[i -1];
 
 		if(scroll.updateScrolling())
-			doRedraw = true;
+			doUpdate = true;
 	}
 
-	if(doRedraw)
+	if(foregroundMaskRotation != SmartMatrix::screenConfig.rotation)
+	{
+		// local height changed, scrollers may be clipped differently
 		redrawForeground();
-}
+		return true;
+	}
 
-// returns true and copies color to xyPixel if pixel is opaque, returns false if not
-bool SmartMatrix::getForegroundPixel(uint8_t hardwareX, uint8_t hardwareY, rgb24 *xyPixel) {
-    uint8_t localScreenX, localScreenY;
+	if(!doUpdate)
+		return false;
 
-    // convert hardware x/y to the pixel in the local screen
-    switch( SmartMatrix::screenConfig.rotation ) {
-      case rotation0 :
-        localScreenX = hardwareX;
-        localScreenY = hardwareY;
-        break;
-      case rotation180 :
-        localScreenX = (MATRIX_WIDTH - 1) - hardwareX;
-        localScreenY = (MATRIX_HEIGHT - 1) - hardwareY;
-        break;
-      case  rotation90 :
-        localScreenX = hardwareY;
-        localScreenY = (MATRIX_WIDTH - 1) - hardwareX;
-        break;
-      case  rotation270 :
-        localScreenX = (MATRIX_HEIGHT - 1) - hardwareY;
-        localScreenY = hardwareX;
-        break;
-      default:
-        // TODO: Should throw an error
-        return false;
-    };
+	// scrollers that moved one pixel are shifted with only the new column drawn, anything else needs a full redraw
+	if(canShiftForeground())
+	{
+		for(size_t i=MATRIX_SCROLLERS; i>0; --i)
+		{
+			TextScroller &scroll = scrollers[i -1];
 
-    uint8_t panelIndex = localScreenX >> 5;
-    uint8_t panelScreenX = localScreenX - (panelIndex * 32);
-    uint32_t bitmask = 0x01 << (31 - panelScreenX);
+			if(!scroll.isFramebufferCurrent())
+				scroll.shiftFramebuffer(i -1);
+		}
 
-	if(foregroundBitmap[foregroundRefreshBuffer][localScreenY][panelIndex] & bitmask)
-	{
-		size_t i = foregroundColorLines[foregroundRefreshBuffer][localScreenY];
-		if(i < MATRIX_SCROLLERS)
-			*xyPixel = scrollers[i].textColor;
-		else
-			*xyPixel = scrollers[0].textColor;
+		updateForegroundMask();
+	} else
+		redrawForeground();
 
-		return true;
+	return true;
+}
+
+// returns the hardware orientation foreground mask for a row, MSB of each word is the leftmost of 32 columns
+const uint32_t *SmartMatrix::getForegroundMaskRow(uint8_t hardwareY) {
+	return foregroundMask[hardwareY];
+}
+
+// returns the scroller index of each column in a row, stepping by columnStride (0 if the whole row is one color)
+const uint8_t *SmartMatrix::getForegroundColorIndexes(uint8_t hardwareY, int *columnStride) {
+	if(foregroundColorsPerColumn)
+	{
+		*columnStride = 1;
+		return foregroundColumnColors;
 	}
 
-    return false;
+	*columnStride = 0;
+	return &foregroundRowColors[hardwareY];
 }
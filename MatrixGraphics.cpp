@@ -24,73 +24,250 @@
 #include <stdlib.h>
 #include "SmartMatrix.h"
 
-static rgb24 backgroundBuffer[2][MATRIX_HEIGHT][MATRIX_WIDTH];
+static bgcolor_t backgroundBuffer[BACKGROUND_BUFFERS][MATRIX_HEIGHT][MATRIX_WIDTH];
 
-static rgb24 (*currentDrawBufferPtr)[MATRIX_WIDTH] = backgroundBuffer[0];
-static rgb24 (*currentRefreshBufferPtr)[MATRIX_WIDTH] = backgroundBuffer[1];
+static bgcolor_t (*currentDrawBufferPtr)[MATRIX_WIDTH] = backgroundBuffer[0];
+static bgcolor_t (*currentRefreshBufferPtr)[MATRIX_WIDTH] = backgroundBuffer[1];
 unsigned char SmartMatrix::currentDrawBuffer = 0;
 unsigned char SmartMatrix::currentRefreshBuffer = 1;
 volatile bool SmartMatrix::swapPending = false;
+
+#if BACKGROUND_BUFFERS > 2
+// third buffer, passed between swapBuffers() and the refresh with an atomic exchange so neither side waits:
+// the buffer index, with READY_FRAME set while it holds a completed frame the refresh hasn't picked up yet
+#define READY_FRAME     0x80
+static uint8_t readyBuffer = 2;
+static swapModes swapMode = swapLatest;
+
+// refresh frame each buffer is to be shown from, set when the frame is completed
+static uint32_t bufferTargetFrame[BACKGROUND_BUFFERS];
+
+#if BACKGROUND_LOCAL_COORDINATES
+// rotation each buffer was drawn in, set when the frame is completed
+static rotationDegrees bufferRotation[BACKGROUND_BUFFERS];
+#endif
+#else
+// refresh frame the pending swap is to happen in
+static uint32_t swapTargetFrame;
+#endif
 static bitmap_font *font = (bitmap_font *) &apple3x5;
 
-// coordinates based on screen position, which is between 0-localWidth/localHeight
+#if BACKGROUND_LOCAL_COORDINATES
+// rotation the refresh buffer was drawn in, taken from the drawing rotation when buffers are swapped
+static rotationDegrees refreshRotation = rotation0;
+
+// position of hardware pixel (x, y) in a buffer kept in local coordinates: rowOrigin + y*rowStep + x*columnStep
+typedef struct refreshStride {
+    int rowOrigin;
+    int rowStep;
+    int columnStep;
+} refreshStride;
+
+// order needs to match rotationDegrees enum
+static const refreshStride refreshStrideTable[] = {
+    { 0, MATRIX_WIDTH, 1 },
+    { (MATRIX_WIDTH - 1) * MATRIX_HEIGHT, 1, -MATRIX_HEIGHT },
+    { (MATRIX_HEIGHT * MATRIX_WIDTH) - 1, -MATRIX_WIDTH, -1 },
+    { MATRIX_HEIGHT - 1, -1, MATRIX_HEIGHT },
+};
+#endif
+
+// coordinates based on hardware position, which is between 0-MATRIX_WIDTH/MATRIX_HEIGHT
 void SmartMatrix::getPixel(uint8_t x, uint8_t y, rgb24 *xyPixel) {
-    *xyPixel =  currentRefreshBufferPtr[y][x];
+    int columnStride;
+#if BACKGROUND_INDEXED_COLOR
+    *xyPixel = getRefreshPalette()[getRefreshRow(y, &columnStride)[x * columnStride]];
+#elif BACKGROUND_RGB565
+    const rgb16 pixel = getRefreshRow(y, &columnStride)[x * columnStride];
+    *xyPixel = rgb24(pixel.red(), pixel.green(), pixel.blue());
+#else
+    *xyPixel = getRefreshRow(y, &columnStride)[x * columnStride];
+#endif
 }
 
-rgb24 *SmartMatrix::getRefreshRow(uint8_t y) {
-  return currentRefreshBufferPtr[y];
+// returns hardware column 0 of refresh buffer row y, with the distance between columns
+bgcolor_t *SmartMatrix::getRefreshRow(uint8_t y, int *columnStride) {
+#if BACKGROUND_LOCAL_COORDINATES
+    const refreshStride *stride = &refreshStrideTable[refreshRotation];
+
+    *columnStride = stride->columnStep;
+    return &currentRefreshBufferPtr[0][0] + stride->rowOrigin + (y * stride->rowStep);
+#else
+    *columnStride = 1;
+    return currentRefreshBufferPtr[y];
+#endif
 }
 
-// reads pixel from drawing buffer, not refresh buffer
-const rgb24 SmartMatrix::readPixel(int16_t x, int16_t y) const {
-    int hwx, hwy;
+// local coordinates of hardware column 0 in row hardwareY, and the local step for each hardware column
+void SmartMatrix::getLocalRowPosition(uint8_t hardwareY, int *x, int *y, int *stepX, int *stepY) {
+    switch (screenConfig.rotation) {
+    case rotation0:
+        *x = 0;
+        *y = hardwareY;
+        *stepX = 1;
+        *stepY = 0;
+        break;
+    case rotation90:
+        *x = hardwareY;
+        *y = MATRIX_WIDTH - 1;
+        *stepX = 0;
+        *stepY = -1;
+        break;
+    case rotation180:
+        *x = MATRIX_WIDTH - 1;
+        *y = MATRIX_HEIGHT - 1 - hardwareY;
+        *stepX = -1;
+        *stepY = 0;
+        break;
+    case rotation270:
+    default:
+        *x = MATRIX_HEIGHT - 1 - hardwareY;
+        *y = 0;
+        *stepX = 0;
+        *stepY = 1;
+        break;
+    }
+}
 
-    // check for out of bounds coordinates
-    if (x < 0 || y < 0 || x >= screenConfig.localWidth || y >= screenConfig.localHeight)
-        return rgb24(0, 0, 0);
+// background scroll registers written by the application, copied for the refresh at the start of a frame
+typedef struct backgroundScrollRegisters {
+    const bgcolor_t *image;
+    uint16_t imageWidth;
+    uint16_t imageHeight;
+    int16_t scrollX;
+    int16_t scrollY;
+} backgroundScrollRegisters;
+
+static backgroundScrollRegisters backgroundScroll;
+static backgroundScrollRegisters refreshBackgroundScroll;
+static volatile bool backgroundScrollPending = false;
+
+// local screen coordinates (0,0) show background pixel (x,y), the background wraps around at its edges
+void SmartMatrix::setBackgroundScroll(int16_t x, int16_t y) {
+    noInterrupts();
+    backgroundScroll.scrollX = x;
+    backgroundScroll.scrollY = y;
+    backgroundScrollPending = true;
+    interrupts();
+}
 
-    // map pixel into hardware buffer before writing
-    if (screenConfig.rotation == rotation0) {
-        hwx = x;
-        hwy = y;
-    } else if (screenConfig.rotation == rotation180) {
-        hwx = (MATRIX_WIDTH - 1) - x;
-        hwy = (MATRIX_HEIGHT - 1) - y;
-    } else if (screenConfig.rotation == rotation90) {
-        hwx = (MATRIX_WIDTH - 1) - y;
-        hwy = x;
-    } else { /* if (screenConfig.rotation == rotation270)*/
-        hwx = y;
-        hwy = (MATRIX_HEIGHT - 1) - x;
-    }
+// show image, width x height pixels row by row in local coordinates, instead of the background buffers
+// it can be larger than the screen to pan over with setBackgroundScroll(), NULL shows the buffers again
+void SmartMatrix::setBackgroundImage(const bgcolor_t *image, uint16_t width, uint16_t height) {
+    noInterrupts();
+    backgroundScroll.image = (width && height) ? image : NULL;
+    backgroundScroll.imageWidth = width;
+    backgroundScroll.imageHeight = height;
+    backgroundScrollPending = true;
+    interrupts();
+}
+
+// called by the refresh once per frame, returns true if the registers changed
+bool SmartMatrix::handleBackgroundScrollUpdate(void) {
+    if (!backgroundScrollPending)
+        return false;
 
-    return currentDrawBufferPtr[hwy][hwx];
+    refreshBackgroundScroll = backgroundScroll;
+    backgroundScrollPending = false;
+    return true;
 }
 
-void SmartMatrix::drawPixel(int16_t x, int16_t y, const rgb24& color) {
-    int hwx, hwy;
+// returns hardware row hardwareY of the background as shown with the scroll applied, with the distance between columns
+// rows that wrap around or come from the background image are gathered into row
+const bgcolor_t *SmartMatrix::getScrolledRefreshRow(uint8_t hardwareY, bgcolor_t *row, int *columnStride) {
+    const backgroundScrollRegisters *scroll = &refreshBackgroundScroll;
+
+    if (scroll->image) {
+        const int width = scroll->imageWidth;
+        const int height = scroll->imageHeight;
+        int x, y, stepX, stepY;
+
+        getLocalRowPosition(hardwareY, &x, &y, &stepX, &stepY);
+
+        x = (x + scroll->scrollX) % width;
+        if (x < 0)
+            x += width;
+        y = (y + scroll->scrollY) % height;
+        if (y < 0)
+            y += height;
+
+        for (int i = 0; i < MATRIX_WIDTH; i++) {
+            row[i] = scroll->image[y * width + x];
+
+            x += stepX;
+            if (x >= width)
+                x = 0;
+            else if (x < 0)
+                x = width - 1;
+
+            y += stepY;
+            if (y >= height)
+                y = 0;
+            else if (y < 0)
+                y = height - 1;
+        }
 
-    // check for out of bounds coordinates
-    if (x < 0 || y < 0 || x >= screenConfig.localWidth || y >= screenConfig.localHeight)
-        return;
+        *columnStride = 1;
+        return row;
+    }
 
-    // map pixel into hardware buffer before writing
-    if (screenConfig.rotation == rotation0) {
-        hwx = x;
-        hwy = y;
-    } else if (screenConfig.rotation == rotation180) {
-        hwx = (MATRIX_WIDTH - 1) - x;
-        hwy = (MATRIX_HEIGHT - 1) - y;
-    } else if (screenConfig.rotation == rotation90) {
-        hwx = (MATRIX_WIDTH - 1) - y;
-        hwy = x;
-    } else { /* if (screenConfig.rotation == rotation270)*/
-        hwx = y;
-        hwy = (MATRIX_HEIGHT - 1) - x;
+    if (!scroll->scrollX && !scroll->scrollY)
+        return getRefreshRow(hardwareY, columnStride);
+
+    // the buffers wrap at the panel edges, so a scroll in local coordinates is a scroll in hardware coordinates
+    // with BACKGROUND_LOCAL_COORDINATES, that's the rotation the refresh buffer was drawn in, not the current one
+#if BACKGROUND_LOCAL_COORDINATES
+    const rotationDegrees rotation = refreshRotation;
+#else
+    const rotationDegrees rotation = screenConfig.rotation;
+#endif
+    int offsetX, offsetY;
+    switch (rotation) {
+    case rotation0:
+        offsetX = scroll->scrollX;
+        offsetY = scroll->scrollY;
+        break;
+    case rotation90:
+        offsetX = -scroll->scrollY;
+        offsetY = scroll->scrollX;
+        break;
+    case rotation180:
+        offsetX = -scroll->scrollX;
+        offsetY = -scroll->scrollY;
+        break;
+    case rotation270:
+    default:
+        offsetX = scroll->scrollY;
+        offsetY = -scroll->scrollX;
+        break;
     }
 
-    currentDrawBufferPtr[hwy][hwx] = color;
+    offsetX %= MATRIX_WIDTH;
+    if (offsetX < 0)
+        offsetX += MATRIX_WIDTH;
+    offsetY %= MATRIX_HEIGHT;
+    if (offsetY < 0)
+        offsetY += MATRIX_HEIGHT;
+
+    const bgcolor_t *source = getRefreshRow((hardwareY + offsetY) % MATRIX_HEIGHT, columnStride);
+
+    if (!offsetX)
+        return source;
+
+    const int stride = *columnStride;
+    if (stride == 1) {
+        memcpy((uint8_t *)row, (const uint8_t *)(source + offsetX), (MATRIX_WIDTH - offsetX) * sizeof(bgcolor_t));
+        memcpy((uint8_t *)(row + MATRIX_WIDTH - offsetX), (const uint8_t *)source, offsetX * sizeof(bgcolor_t));
+    } else {
+        for (int i = 0; i < MATRIX_WIDTH; i++) {
+            row[i] = source[offsetX * stride];
+            if (++offsetX == MATRIX_WIDTH)
+                offsetX = 0;
+        }
+    }
+
+    *columnStride = 1;
+    return row;
 }
 
 #define SWAPint(X,Y) { \
@@ -99,152 +276,448 @@ void SmartMatrix::drawPixel(int16_t x, int16_t y, const rgb24& color) {
         Y = temp ; \
     }
 
-// x0, x1, and y must be in bounds (0-localWidth/Height), x1 > x0
-void SmartMatrix::drawHardwareHLine(uint16_t x0, uint16_t x1, uint16_t y, const rgb24& color) {
-    int i;
+// mapping of local screen coordinates into the hardware drawing buffer for each rotation:
+// the offset of local pixel (0,0) and the offsets to step one local column and one local row
+// with BACKGROUND_LOCAL_COORDINATES the buffer is in local coordinates and rotation only sets the row length
+template <rotationDegrees rotation>
+struct rotationMap {
+    static const int localWidth = (rotation == rotation0 || rotation == rotation180) ? MATRIX_WIDTH : MATRIX_HEIGHT;
+    static const int localHeight = (rotation == rotation0 || rotation == rotation180) ? MATRIX_HEIGHT : MATRIX_WIDTH;
+
+#if BACKGROUND_LOCAL_COORDINATES
+    static const int origin = 0;
+    static const int xStep = 1;
+    static const int yStep = localWidth;
+#else
+    static const int origin = (rotation == rotation0) ? 0 :
+                              (rotation == rotation180) ? (MATRIX_HEIGHT * MATRIX_WIDTH) - 1 :
+                              (rotation == rotation90) ? MATRIX_WIDTH - 1 :
+                              (MATRIX_HEIGHT - 1) * MATRIX_WIDTH;
+    static const int xStep = (rotation == rotation0) ? 1 :
+                             (rotation == rotation180) ? -1 :
+                             (rotation == rotation90) ? MATRIX_WIDTH :
+                             -MATRIX_WIDTH;
+    static const int yStep = (rotation == rotation0) ? MATRIX_WIDTH :
+                             (rotation == rotation180) ? -MATRIX_WIDTH :
+                             (rotation == rotation90) ? -1 :
+                             1;
+#endif
+
+    // pixels in each row of the buffer
+#if BACKGROUND_LOCAL_COORDINATES
+    static const int bufferWidth = localWidth;
+#else
+    static const int bufferWidth = MATRIX_WIDTH;
+#endif
+
+    // x and y must be in bounds of the local screen
+    static bgcolor_t *pixel(int x, int y) {
+        return &currentDrawBufferPtr[0][0] + origin + (x * xStep) + (y * yStep);
+    }
+};
+
+// regions of the background buffers tracked so swapping with a copy only copies what changed:
+// columns start to end-1 of each buffer row, a row is empty when end is 0
+#if BACKGROUND_LOCAL_COORDINATES
+#define DIRTY_ROWS  ((MATRIX_WIDTH > MATRIX_HEIGHT) ? MATRIX_WIDTH : MATRIX_HEIGHT)
+#else
+#define DIRTY_ROWS  MATRIX_HEIGHT
+#endif
+
+typedef struct dirtyRegion {
+    uint16_t start[DIRTY_ROWS];
+    uint16_t end[DIRTY_ROWS];
+} dirtyRegion;
+
+// drawnRegion is what was drawn since the last swap, staleRegion[i] is where buffer i may differ from the drawing buffer
+// the bounding rectangle in local coordinates of what was drawn since the last swap with copy is kept for the application
+static dirtyRegion drawnRegion;
+static dirtyRegion staleRegion[BACKGROUND_BUFFERS];
+static int dirtyRowWidth = MATRIX_WIDTH;
+// the rectangle is only kept across swaps without copy, getDirtyRect() adds drawnRegion to it when called
+static bool dirtyLocalValid = false;
+static int16_t dirtyLocalX0, dirtyLocalY0, dirtyLocalX1, dirtyLocalY1;
+
+static void addDirtySpan(dirtyRegion *region, int row, int column0, int columnEnd) {
+    if (!region->end[row]) {
+        region->start[row] = column0;
+        region->end[row] = columnEnd;
+    } else {
+        if (column0 < region->start[row])
+            region->start[row] = column0;
+        if (columnEnd > region->end[row])
+            region->end[row] = columnEnd;
+    }
+}
 
-    for (i = x0; i <= x1; i++) {
-        currentDrawBufferPtr[y][i] = color;
+static void mergeDirtyRegion(dirtyRegion *dest, const dirtyRegion *source) {
+    for (int i = 0; i < DIRTY_ROWS; i++) {
+        if (source->end[i])
+            addDirtySpan(dest, i, source->start[i], source->end[i]);
     }
 }
 
-// x, y0, and y1 must be in bounds (0-localWidth/Height), y1 > y0
-void SmartMatrix::drawHardwareVLine(uint16_t x, uint16_t y0, uint16_t y1, const rgb24& color) {
-    int i;
+static void clearDirtyRegion(dirtyRegion *region) {
+    for (int i = 0; i < DIRTY_ROWS; i++)
+        region->end[i] = 0;
+}
+
+// brings the region of one buffer up to date from another, and clears it
+static void copyDirtyRegion(bgcolor_t *dest, const bgcolor_t *source, dirtyRegion *region) {
+    for (int i = 0; i < DIRTY_ROWS; i++) {
+        if (!region->end[i])
+            continue;
+
+        int offset = i * dirtyRowWidth + region->start[i];
+        memcpy((uint8_t *)(dest + offset), (const uint8_t *)(source + offset), (region->end[i] - region->start[i]) * sizeof(bgcolor_t));
+        region->end[i] = 0;
+    }
+}
+
+// drawing into completedBuffer is finished: every other buffer now lacks what was drawn
+static void completeDrawnRegion(unsigned char completedBuffer) {
+    for (int i = 0; i < BACKGROUND_BUFFERS; i++) {
+        if (i != completedBuffer)
+            mergeDirtyRegion(&staleRegion[i], &drawnRegion);
+    }
+    clearDirtyRegion(&drawnRegion);
+}
+
+// drawing continues in newBuffer without copying into it: every other buffer now differs by what newBuffer lacks too
+static void keepStaleRegion(unsigned char newBuffer) {
+    for (int i = 0; i < BACKGROUND_BUFFERS; i++) {
+        if (i != newBuffer)
+            mergeDirtyRegion(&staleRegion[i], &staleRegion[newBuffer]);
+    }
+    clearDirtyRegion(&staleRegion[newBuffer]);
+}
+
+// grows the bounding rectangle of what was drawn before swaps without copy, in local coordinates
+static void markDirtyLocal(int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+    if (!dirtyLocalValid) {
+        dirtyLocalX0 = x0;
+        dirtyLocalY0 = y0;
+        dirtyLocalX1 = x1;
+        dirtyLocalY1 = y1;
+        dirtyLocalValid = true;
+    } else {
+        if (x0 < dirtyLocalX0) dirtyLocalX0 = x0;
+        if (y0 < dirtyLocalY0) dirtyLocalY0 = y0;
+        if (x1 > dirtyLocalX1) dirtyLocalX1 = x1;
+        if (y1 > dirtyLocalY1) dirtyLocalY1 = y1;
+    }
+}
+
+// marks a rectangle in local coordinates as changed, clipped to the screen
+template <rotationDegrees rotation>
+static void markDirtyRotated(int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+    typedef rotationMap<rotation> map;
+
+    if (x1 < x0)
+        SWAPint(x1, x0);
+    if (y1 < y0)
+        SWAPint(y1, y0);
+
+    if (x1 < 0 || y1 < 0 || x0 >= map::localWidth || y0 >= map::localHeight)
+        return;
+
+    if (x0 < 0)
+        x0 = 0;
+    if (y0 < 0)
+        y0 = 0;
+    if (x1 >= map::localWidth)
+        x1 = map::localWidth - 1;
+    if (y1 >= map::localHeight)
+        y1 = map::localHeight - 1;
+
+    // the rectangle is a rectangle in the buffer too, from the corner at the lowest address to the highest
+    int first = map::origin + ((map::xStep > 0) ? x0 : x1) * map::xStep + ((map::yStep > 0) ? y0 : y1) * map::yStep;
+    int last = map::origin + ((map::xStep > 0) ? x1 : x0) * map::xStep + ((map::yStep > 0) ? y1 : y0) * map::yStep;
+
+    int row0 = first / map::bufferWidth;
+    int row1 = last / map::bufferWidth;
+    for (int i = row0; i <= row1; i++)
+        addDirtySpan(&drawnRegion, i, first % map::bufferWidth, (last % map::bufferWidth) + 1);
+}
+
+template <rotationDegrees rotation>
+static bgcolor_t readPixelRotated(int16_t x, int16_t y) {
+    typedef rotationMap<rotation> map;
+
+    // check for out of bounds coordinates
+    if (x < 0 || y < 0 || x >= map::localWidth || y >= map::localHeight)
+        return bgcolor_t();
+
+    return *map::pixel(x, y);
+}
+
+template <rotationDegrees rotation>
+static void drawPixelRotated(int16_t x, int16_t y, const bgcolor_t& color) {
+    typedef rotationMap<rotation> map;
+
+    // check for out of bounds coordinates
+    if (x < 0 || y < 0 || x >= map::localWidth || y >= map::localHeight)
+        return;
+
+    *map::pixel(x, y) = color;
+}
+
+// public drawPixel: marks the pixel changed and draws it with a single dispatch through the rotated drawing table
+template <rotationDegrees rotation>
+static void plotPixelRotated(int16_t x, int16_t y, const bgcolor_t& color) {
+    typedef rotationMap<rotation> map;
+
+    if (x < 0 || y < 0 || x >= map::localWidth || y >= map::localHeight)
+        return;
+
+    // a single pixel is a one column span of one buffer row, no need for the clipping in markDirtyRotated
+    int offset = map::origin + (x * map::xStep) + (y * map::yStep);
+    addDirtySpan(&drawnRegion, offset / map::bufferWidth, offset % map::bufferWidth, (offset % map::bufferWidth) + 1);
+
+    (&currentDrawBufferPtr[0][0])[offset] = color;
+}
+
+// 32-bit stores into the background buffers, tell the compiler they may alias the pixels
+typedef uint32_t __attribute__((__may_alias__)) pixelWord;
 
-    for (i = y0; i <= y1; i++) {
-        currentDrawBufferPtr[i][x] = color;
+#if BACKGROUND_INDEXED_COLOR
+// fills count pixels starting at start, which must be contiguous in the buffer, palette indexes are single bytes
+static void fillSpan(bgcolor_t *start, int count, const bgcolor_t& color) {
+    memset(start, color, count);
+}
+#elif BACKGROUND_RGB565
+// fills count pixels starting at start, which must be contiguous in the buffer
+// colors with both bytes the same are a memset, others are stored two pixels to an aligned word
+static void fillSpan(bgcolor_t *start, int count, const bgcolor_t& color) {
+    if ((color.rgb >> 8) == (color.rgb & 0xff)) {
+        memset((uint8_t *)start, color.rgb & 0xff, count * sizeof(rgb16));
+        return;
     }
+
+    if (count > 0 && ((uintptr_t)start & 2)) {
+        *start++ = color;
+        count--;
+    }
+
+    uint32_t word = color.rgb | ((uint32_t)color.rgb << 16);
+    uintptr_t wordAddress = (uintptr_t)start;
+    pixelWord *words = (pixelWord *)wordAddress;
+
+    for (; count >= 2; count -= 2)
+        *words++ = word;
+
+    start = (bgcolor_t *)words;
+    if (count > 0)
+        *start = color;
 }
+#else
+// fills count pixels starting at start, which must be contiguous in the buffer
+// grey and black are the same byte repeated so they're a memset, other colors are stored as a repeating
+// pattern of three aligned words holding four pixels, with single pixels before and after
+static void fillSpan(rgb24 *start, int count, const rgb24& color) {
+    if (color.red == color.green && color.green == color.blue) {
+        memset((uint8_t *)start, color.red, count * sizeof(rgb24));
+        return;
+    }
+
+    while (count > 0 && ((uintptr_t)start & 3)) {
+        *start++ = color;
+        count--;
+    }
+
+    if (count >= 4) {
+        // four pixels are three words
+        uint8_t pattern[4 * sizeof(rgb24)];
+        for (int i = 0; i < 4; i++)
+            memcpy(pattern + (i * sizeof(rgb24)), &color, sizeof(rgb24));
+        uint32_t word0, word1, word2;
+        memcpy(&word0, pattern, sizeof(word0));
+        memcpy(&word1, pattern + 4, sizeof(word1));
+        memcpy(&word2, pattern + 8, sizeof(word2));
+        uintptr_t wordAddress = (uintptr_t)start;
+        pixelWord *words = (pixelWord *)wordAddress;
+
+        for (; count >= 4; count -= 4, words += 3) {
+            words[0] = word0;
+            words[1] = word1;
+            words[2] = word2;
+        }
+
+        start = (rgb24 *)words;
+    }
+
+    while (count-- > 0)
+        *start++ = color;
+}
+#endif
+
+// fills pixels a to b of a line stepping step pixels through the buffer, as a span when they're contiguous
+template <int step>
+static inline void fillLine(bgcolor_t *a, bgcolor_t *b, int count, const bgcolor_t& color) {
+    if (step == 1) {
+        fillSpan(a, count, color);
+    } else if (step == -1) {
+        fillSpan(b, count, color);
+    } else {
+        for (; count > 0; count--, a += step)
+            *a = color;
+    }
+}
+
+template <rotationDegrees rotation>
+static void drawFastHLineRotated(int16_t x0, int16_t x1, int16_t y, const bgcolor_t& color) {
+    typedef rotationMap<rotation> map;
 
-void SmartMatrix::drawFastHLine(int16_t x0, int16_t x1, int16_t y, const rgb24& color) {
     // make sure line goes from x0 to x1
     if (x1 < x0)
         SWAPint(x1, x0);
 
     // check for completely out of bounds line
-    if (x1 < 0 || x0 >= screenConfig.localWidth || y < 0 || y >= screenConfig.localHeight)
+    if (x1 < 0 || x0 >= map::localWidth || y < 0 || y >= map::localHeight)
         return;
 
     // truncate if partially out of bounds
     if (x0 < 0)
         x0 = 0;
 
-    if (x1 >= screenConfig.localWidth)
-        x1 = screenConfig.localWidth - 1;
+    if (x1 >= map::localWidth)
+        x1 = map::localWidth - 1;
 
-    // map to hardware drawline function
-    if (screenConfig.rotation == rotation0) {
-        drawHardwareHLine(x0, x1, y, color);
-    } else if (screenConfig.rotation == rotation180) {
-        drawHardwareHLine((MATRIX_WIDTH - 1) - x1, (MATRIX_WIDTH - 1) - x0, (MATRIX_HEIGHT - 1) - y, color);
-    } else if (screenConfig.rotation == rotation90) {
-        drawHardwareVLine((MATRIX_WIDTH - 1) - y, x0, x1, color);
-    } else { /* if (screenConfig.rotation == rotation270)*/
-        drawHardwareVLine(y, (MATRIX_HEIGHT - 1) - x1, (MATRIX_HEIGHT - 1) - x0, color);
-    }
+    fillLine<map::xStep>(map::pixel(x0, y), map::pixel(x1, y), (x1 - x0) + 1, color);
 }
 
-void SmartMatrix::drawFastVLine(int16_t x, int16_t y0, int16_t y1, const rgb24& color) {
+template <rotationDegrees rotation>
+static void drawFastVLineRotated(int16_t x, int16_t y0, int16_t y1, const bgcolor_t& color) {
+    typedef rotationMap<rotation> map;
+
     // make sure line goes from y0 to y1
     if (y1 < y0)
         SWAPint(y1, y0);
 
     // check for completely out of bounds line
-    if (y1 < 0 || y0 >= screenConfig.localHeight || x < 0 || x >= screenConfig.localWidth)
+    if (y1 < 0 || y0 >= map::localHeight || x < 0 || x >= map::localWidth)
         return;
 
     // truncate if partially out of bounds
     if (y0 < 0)
         y0 = 0;
 
-    if (y1 >= screenConfig.localHeight)
-        y1 = screenConfig.localHeight - 1;
+    if (y1 >= map::localHeight)
+        y1 = map::localHeight - 1;
 
-    // map to hardware drawline function
-    if (screenConfig.rotation == rotation0) {
-        drawHardwareVLine(x, y0, y1, color);
-    } else if (screenConfig.rotation == rotation180) {
-        drawHardwareVLine((MATRIX_WIDTH - 1) - x, (MATRIX_HEIGHT - 1) - y1, (MATRIX_HEIGHT - 1) - y0, color);
-    } else if (screenConfig.rotation == rotation90) {
-        drawHardwareHLine((MATRIX_WIDTH - 1) - y1, (MATRIX_WIDTH - 1) - y0, x, color);
-    } else { /* if (screenConfig.rotation == rotation270)*/
-        drawHardwareHLine(y0, y1, (MATRIX_HEIGHT - 1) - x, color);
-    }
+    fillLine<map::yStep>(map::pixel(x, y0), map::pixel(x, y1), (y1 - y0) + 1, color);
 }
 
-void SmartMatrix::bresteepline(int16_t x3, int16_t y3, int16_t x4, int16_t y4, const rgb24& color) {
-    // if point x3, y3 is on the right side of point x4, y4, change them
-    if ((x3 - x4) > 0) {
-        bresteepline(x4, y4, x3, y3, color);
+// Bresenham line, algorithm from http://www.netgraphics.sk/bresenham-algorithm-for-a-line
+// walked along its major axis from (major, minor), length steps long with the minor axis changing
+// by rise, on a screen majorSize by minorSize.  The line is clipped before drawing: only the steps that land
+// on screen are walked, starting with the error term the full walk would have there, so the pixels are the
+// same as drawing every point of the line.  Pixels are stored through a pointer moved by the buffer strides
+static void drawClippedLine(int major, int minor, int length, int rise, int majorSize, int minorSize,
+  bgcolor_t *base, int majorStride, int minorStride, const bgcolor_t& color) {
+    int minorDirection = 1;
+    if (rise < 0) {
+        rise = -rise;
+        minorDirection = -1;
+    }
+
+    // the walk is steps 0 to length, with k minor steps taken before step i where k = ceil((2*rise*i - length) / (2*length))
+    int first = (major < 0) ? -major : 0;
+    int last = (major + length >= majorSize) ? majorSize - 1 - major : length;
+
+    // minor steps that keep the line on screen
+    int kLow = (minorDirection > 0) ? -minor : minor - (minorSize - 1);
+    int kHigh = (minorDirection > 0) ? (minorSize - 1) - minor : minor;
+    if (kHigh < 0 || kLow > rise)
         return;
+
+    // first step taking at least kLow minor steps, and last step taking at most kHigh
+    if (kLow > 0) {
+        int stepIn = (int)(((int64_t)2 * length * kLow - length) / (2 * rise)) + 1;
+        if (stepIn > first)
+            first = stepIn;
     }
+    if (kHigh < rise) {
+        int stepOut = (int)(((int64_t)2 * length * (kHigh + 1) - length) / (2 * rise));
+        if (stepOut < last)
+            last = stepOut;
+    }
+    if (first > last)
+        return;
 
-    int x = x3, y = y3, sum = x4 - x3,  Dx = 2 * (x4 - x3), Dy = abs(2 * (y4 - y3));
-    int prirastokDy = ((y4 - y3) > 0) ? 1 : -1;
+    int k = 0;
+    int64_t error = (int64_t)2 * rise * first - length;
+    if (error > 0)
+        k = (int)((error + 2 * length - 1) / (2 * length));
+    int sum = (int)(length - (int64_t)2 * rise * first + (int64_t)2 * length * k);
 
-    for (int i = 0; i <= x4 - x3; i++) {
-        drawPixel(y, x, color);
-        x++;
-        sum -= Dy;
+    bgcolor_t *p = base + (major + first) * majorStride + (minor + minorDirection * k) * minorStride;
+    int minorStep = minorDirection * minorStride;
+
+    for (int i = first; i <= last; i++) {
+        *p = color;
+        p += majorStride;
+        sum -= 2 * rise;
         if (sum < 0) {
-            y = y + prirastokDy;
-            sum += Dx;
+            p += minorStep;
+            sum += 2 * length;
         }
     }
 }
 
-// algorithm from http://www.netgraphics.sk/bresenham-algorithm-for-a-line
-void SmartMatrix::drawLine(int16_t x1, int16_t y1, int16_t x2, int16_t y2, const rgb24& color) {
-    // if point x1, y1 is on the right side of point x2, y2, change them
-    if ((x1 - x2) > 0) {
-        drawLine(x2, y2, x1, y1, color);
-        return;
-    }
-    // test inclination of line
-    // function Math.abs(y) defines absolute value y
+template <rotationDegrees rotation>
+static void drawLineRotated(int16_t x1, int16_t y1, int16_t x2, int16_t y2, const bgcolor_t& color) {
+    typedef rotationMap<rotation> map;
+    bgcolor_t *base = &currentDrawBufferPtr[0][0] + map::origin;
+
+    // step along the axis the line changes most in, in increasing order along it
     if (abs(y2 - y1) > abs(x2 - x1)) {
-        // line and y axis angle is less then 45 degrees
-        // thats why go on the next procedure
-        bresteepline(y1, x1, y2, x2, color); return;
-    }
-    // line and x axis angle is less then 45 degrees, so x is guiding
-    // auxiliary variables
-    int x = x1, y = y1, sum = x2 - x1, Dx = 2 * (x2 - x1), Dy = abs(2 * (y2 - y1));
-    int prirastokDy = ((y2 - y1) > 0) ? 1 : -1;
-    // draw line
-    for (int i = 0; i <= x2 - x1; i++) {
-        drawPixel(x, y, color);
-        x++;
-        sum -= Dy;
-        if (sum < 0) {
-            y = y + prirastokDy;
-            sum += Dx;
+        if (y1 > y2) {
+            SWAPint(x1, x2);
+            SWAPint(y1, y2);
+        }
+        drawClippedLine(y1, x1, y2 - y1, x2 - x1, map::localHeight, map::localWidth, base, map::yStep, map::xStep, color);
+    } else {
+        if (x1 > x2) {
+            SWAPint(x1, x2);
+            SWAPint(y1, y2);
         }
+        drawClippedLine(x1, y1, x2 - x1, y2 - y1, map::localWidth, map::localHeight, base, map::xStep, map::yStep, color);
     }
 }
 
+// connected lines through the points, back to the first point when closed
+template <rotationDegrees rotation>
+static void drawPolylineRotated(const int16_t x[], const int16_t y[], uint8_t numPoints, bool closed, const bgcolor_t& color) {
+    for (int i = 1; i < numPoints; i++)
+        drawLineRotated<rotation>(x[i - 1], y[i - 1], x[i], y[i], color);
+
+    if (closed && numPoints > 2)
+        drawLineRotated<rotation>(x[numPoints - 1], y[numPoints - 1], x[0], y[0], color);
+}
+
 // algorithm from http://en.wikipedia.org/wiki/Midpoint_circle_algorithm
-void SmartMatrix::drawCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb24& color)
+template <rotationDegrees rotation>
+static void drawCircleRotated(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& color)
 {
     int a = radius, b = 0;
     int radiusError = 1 - a;
 
     if (radius == 0) {
-        drawPixel(x0, y0, color);
+        drawPixelRotated<rotation>(x0, y0, color);
         return;
     }
 
     while (a >= b)
     {
-        drawPixel(a + x0, b + y0, color);
-        drawPixel(b + x0, a + y0, color);
-        drawPixel(-a + x0, b + y0, color);
-        drawPixel(-b + x0, a + y0, color);
-        drawPixel(-a + x0, -b + y0, color);
-        drawPixel(-b + x0, -a + y0, color);
-        drawPixel(a + x0, -b + y0, color);
-        drawPixel(b + x0, -a + y0, color);
+        drawPixelRotated<rotation>(a + x0, b + y0, color);
+        drawPixelRotated<rotation>(b + x0, a + y0, color);
+        drawPixelRotated<rotation>(-a + x0, b + y0, color);
+        drawPixelRotated<rotation>(-b + x0, a + y0, color);
+        drawPixelRotated<rotation>(-a + x0, -b + y0, color);
+        drawPixelRotated<rotation>(-b + x0, -a + y0, color);
+        drawPixelRotated<rotation>(a + x0, -b + y0, color);
+        drawPixelRotated<rotation>(b + x0, -a + y0, color);
 
         b++;
         if (radiusError < 0)
@@ -258,7 +731,8 @@ void SmartMatrix::drawCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb2
 }
 
 // algorithm from drawCircle rearranged with hlines drawn between points on the radius
-void SmartMatrix::fillCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb24& outlineColor, const rgb24& fillColor)
+template <rotationDegrees rotation>
+static void fillCircleRotated(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& outlineColor, const bgcolor_t& fillColor)
 {
     int a = radius, b = 0;
     int radiusError = 1 - a;
@@ -272,26 +746,26 @@ void SmartMatrix::fillCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb2
     while (a >= b)
     {
         // this pair sweeps from horizontal center down
-        drawPixel(a + x0, b + y0, outlineColor);
-        drawPixel(-a + x0, b + y0, outlineColor);
-        drawFastHLine((a - 1) + x0, (-a + 1) + x0, b + y0, fillColor);
+        drawPixelRotated<rotation>(a + x0, b + y0, outlineColor);
+        drawPixelRotated<rotation>(-a + x0, b + y0, outlineColor);
+        drawFastHLineRotated<rotation>((a - 1) + x0, (-a + 1) + x0, b + y0, fillColor);
 
         // this pair sweeps from bottom up
-        drawPixel(b + x0, a + y0, outlineColor);
-        drawPixel(-b + x0, a + y0, outlineColor);
+        drawPixelRotated<rotation>(b + x0, a + y0, outlineColor);
+        drawPixelRotated<rotation>(-b + x0, a + y0, outlineColor);
 
         // this pair sweeps from horizontal center up
-        drawPixel(-a + x0, -b + y0, outlineColor);
-        drawPixel(a + x0, -b + y0, outlineColor);
-        drawFastHLine((a - 1) + x0, (-a + 1) + x0, -b + y0, fillColor);
+        drawPixelRotated<rotation>(-a + x0, -b + y0, outlineColor);
+        drawPixelRotated<rotation>(a + x0, -b + y0, outlineColor);
+        drawFastHLineRotated<rotation>((a - 1) + x0, (-a + 1) + x0, -b + y0, fillColor);
 
         // this pair sweeps from top down
-        drawPixel(-b + x0, -a + y0, outlineColor);
-        drawPixel(b + x0, -a + y0, outlineColor);
+        drawPixelRotated<rotation>(-b + x0, -a + y0, outlineColor);
+        drawPixelRotated<rotation>(b + x0, -a + y0, outlineColor);
 
         if (b > 1 && !hlineDrawn) {
-            drawFastHLine((b - 1) + x0, (-b + 1) + x0, a + y0, fillColor);
-            drawFastHLine((b - 1) + x0, (-b + 1) + x0, -a + y0, fillColor);
+            drawFastHLineRotated<rotation>((b - 1) + x0, (-b + 1) + x0, a + y0, fillColor);
+            drawFastHLineRotated<rotation>((b - 1) + x0, (-b + 1) + x0, -a + y0, fillColor);
             hlineDrawn = true;
         }
 
@@ -309,7 +783,8 @@ void SmartMatrix::fillCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb2
 
 
 // algorithm from drawCircle rearranged with hlines drawn between points on the raidus
-void SmartMatrix::fillCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb24& fillColor)
+template <rotationDegrees rotation>
+static void fillCircleRotated(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& fillColor)
 {
     int a = radius, b = 0;
     int radiusError = 1 - a;
@@ -323,14 +798,14 @@ void SmartMatrix::fillCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb2
     while (a >= b)
     {
         // this pair sweeps from horizontal center down
-        drawFastHLine((a - 1) + x0, (-a + 1) + x0, b + y0, fillColor);
+        drawFastHLineRotated<rotation>((a - 1) + x0, (-a + 1) + x0, b + y0, fillColor);
 
         // this pair sweeps from horizontal center up
-        drawFastHLine((a - 1) + x0, (-a + 1) + x0, -b + y0, fillColor);
+        drawFastHLineRotated<rotation>((a - 1) + x0, (-a + 1) + x0, -b + y0, fillColor);
 
         if (b > 1 && !hlineDrawn) {
-            drawFastHLine((b - 1) + x0, (-b + 1) + x0, a + y0, fillColor);
-            drawFastHLine((b - 1) + x0, (-b + 1) + x0, -a + y0, fillColor);
+            drawFastHLineRotated<rotation>((b - 1) + x0, (-b + 1) + x0, a + y0, fillColor);
+            drawFastHLineRotated<rotation>((b - 1) + x0, (-b + 1) + x0, -a + y0, fillColor);
             hlineDrawn = true;
         }
 
@@ -346,7 +821,8 @@ void SmartMatrix::fillCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb2
 }
 
 // from https://web.archive.org/web/20120225095359/http://homepage.smc.edu/kennedy_john/belipse.pdf
-void SmartMatrix::drawEllipse(int16_t x0, int16_t y0, uint16_t radiusX, uint16_t radiusY, const rgb24& color) {
+template <rotationDegrees rotation>
+static void drawEllipseRotated(int16_t x0, int16_t y0, uint16_t radiusX, uint16_t radiusY, const bgcolor_t& color) {
     int16_t twoASquare = 2 * radiusX * radiusX;
     int16_t twoBSquare = 2 * radiusY * radiusY;
     
@@ -359,10 +835,10 @@ void SmartMatrix::drawEllipse(int16_t x0, int16_t y0, uint16_t radiusX, uint16_t
     int16_t stoppingY = 0;
     
     while (stoppingX >= stoppingY) {    // first set of points, y' > -1
-        drawPixel(x0 + x, y0 + y, color);
-        drawPixel(x0 - x, y0 + y, color);
-        drawPixel(x0 - x, y0 - y, color);
-        drawPixel(x0 + x, y0 - y, color);
+        drawPixelRotated<rotation>(x0 + x, y0 + y, color);
+        drawPixelRotated<rotation>(x0 - x, y0 + y, color);
+        drawPixelRotated<rotation>(x0 - x, y0 - y, color);
+        drawPixelRotated<rotation>(x0 + x, y0 - y, color);
         
         y++;
         stoppingY += twoASquare;
@@ -388,10 +864,10 @@ void SmartMatrix::drawEllipse(int16_t x0, int16_t y0, uint16_t radiusX, uint16_t
     stoppingY = twoASquare * radiusY;
     
     while (stoppingX <= stoppingY) {    // second set of points, y' < -1
-        drawPixel(x0 + x, y0 + y, color);
-        drawPixel(x0 - x, y0 + y, color);
-        drawPixel(x0 - x, y0 - y, color);
-        drawPixel(x0 + x, y0 - y, color);
+        drawPixelRotated<rotation>(x0 + x, y0 + y, color);
+        drawPixelRotated<rotation>(x0 - x, y0 + y, color);
+        drawPixelRotated<rotation>(x0 - x, y0 - y, color);
+        drawPixelRotated<rotation>(x0 + x, y0 - y, color);
         
         x++;
         stoppingX += twoBSquare;
@@ -408,13 +884,13 @@ void SmartMatrix::drawEllipse(int16_t x0, int16_t y0, uint16_t radiusX, uint16_t
 }
 
 void SmartMatrix::fillRoundRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
-  uint16_t radius, const rgb24& fillColor) {
+  uint16_t radius, const bgcolor_t& fillColor) {
     fillRoundRectangle(x0, y0, x1, y1, radius, fillColor, fillColor);
 }
 
 
 void SmartMatrix::fillRoundRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
-  uint16_t radius, const rgb24& outlineColor, const rgb24& fillColor) {
+  uint16_t radius, const bgcolor_t& outlineColor, const bgcolor_t& fillColor) {
     if (x1 < x0)
         SWAPint(x1, x0);
 
@@ -496,7 +972,7 @@ void SmartMatrix::fillRoundRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t
 }
 
 void SmartMatrix::drawRoundRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
-  uint16_t radius, const rgb24& outlineColor) {
+  uint16_t radius, const bgcolor_t& outlineColor) {
     if (x1 < x0)
         SWAPint(x1, x0);
 
@@ -553,168 +1029,438 @@ void SmartMatrix::drawRoundRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t
 }
 
 
-// Code from http://www.sunshine2k.de/coding/java/TriangleRasterization/TriangleRasterization.html
-void SmartMatrix::fillFlatSideTriangleInt(int16_t x1, int16_t y1, int16_t x2, int16_t y2,
-  int16_t x3, int16_t y3, const rgb24& color) {
-    int16_t t1x, t2x, t1y, t2y;
-    bool changed1 = false;
-    bool changed2 = false;
-    int8_t signx1, signx2, signy1, signy2, dx1, dy1, dx2, dy2;
+template <rotationDegrees rotation>
+static void fillRectangleRotated(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const bgcolor_t& color) {
+    typedef rotationMap<rotation> map;
     int i;
-    int8_t e1, e2;
-
-    t1x = t2x = x1; t1y = t2y = y1; // Starting points
 
-    dx1 = abs(x2 - x1);
-    dy1 = abs(y2 - y1);
-    dx2 = abs(x3 - x1);
-    dy2 = abs(y3 - y1);
+    if (y0 > y1) {
+        SWAPint(y0, y1);
+    };
+    if (x0 > x1) {
+        SWAPint(x0, x1);
+    };
 
-    if (x2 - x1 < 0) {
-        signx1 = -1;
-    } else signx1 = 1;
-    if (x3 - x1 < 0) {
-        signx2 = -1;
-    } else signx2 = 1;
-    if (y2 - y1 < 0) {
-        signy1 = -1;
-    } else signy1 = 1;
-    if (y3 - y1 < 0) {
-        signy2 = -1;
-    } else signy2 = 1;
+    // check for completely out of bounds rectangle, then clip it once
+    if (x1 < 0 || y1 < 0 || x0 >= map::localWidth || y0 >= map::localHeight)
+        return;
 
-    if (dy1 > dx1) {   // swap values
-        SWAPint(dx1, dy1);
-        changed1 = true;
+    if (x0 < 0)
+        x0 = 0;
+    if (y0 < 0)
+        y0 = 0;
+    if (x1 >= map::localWidth)
+        x1 = map::localWidth - 1;
+    if (y1 >= map::localHeight)
+        y1 = map::localHeight - 1;
+
+    // a rectangle covering whole lines of the buffer is one span, as the lines are adjacent
+    if ((map::xStep == 1 || map::xStep == -1) ? (x0 == 0 && x1 == map::localWidth - 1) :
+                                                (y0 == 0 && y1 == map::localHeight - 1)) {
+        bgcolor_t *first = map::pixel((map::xStep > 0) ? x0 : x1, (map::yStep > 0) ? y0 : y1);
+        fillSpan(first, ((x1 - x0) + 1) * ((y1 - y0) + 1), color);
+        return;
     }
-    if (dy2 > dx2) {   // swap values
-        SWAPint(dy2, dx2);
-        changed2 = true;
+
+    // otherwise fill along whichever local direction is contiguous in the buffer, so every line is a span
+    if (map::xStep == 1 || map::xStep == -1) {
+        for (i = y0; i <= y1; i++)
+            fillLine<map::xStep>(map::pixel(x0, i), map::pixel(x1, i), (x1 - x0) + 1, color);
+    } else {
+        for (i = x0; i <= x1; i++)
+            fillLine<map::yStep>(map::pixel(i, y0), map::pixel(i, y1), (y1 - y0) + 1, color);
     }
+}
 
-    e1 = 2 * dy1 - dx1;
-    e2 = 2 * dy2 - dx2;
+// drawing functions specialized for one rotation, selected by setRotation so the inner loops of
+// the primitives step through the hardware buffer without checking the rotation for every pixel
+typedef struct rotatedDrawing {
+    bgcolor_t (*readPixel)(int16_t x, int16_t y);
+    void (*plotPixel)(int16_t x, int16_t y, const bgcolor_t& color);
+    void (*drawFastHLine)(int16_t x0, int16_t x1, int16_t y, const bgcolor_t& color);
+    void (*drawFastVLine)(int16_t x, int16_t y0, int16_t y1, const bgcolor_t& color);
+    void (*drawLine)(int16_t x1, int16_t y1, int16_t x2, int16_t y2, const bgcolor_t& color);
+    void (*drawPolyline)(const int16_t x[], const int16_t y[], uint8_t numPoints, bool closed, const bgcolor_t& color);
+    void (*drawCircle)(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& color);
+    void (*fillCircleOutlined)(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& outlineColor, const bgcolor_t& fillColor);
+    void (*fillCircle)(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& fillColor);
+    void (*drawEllipse)(int16_t x0, int16_t y0, uint16_t radiusX, uint16_t radiusY, const bgcolor_t& color);
+    void (*fillRectangle)(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const bgcolor_t& color);
+    void (*markDirty)(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+    int origin;
+    int xStep;
+    int yStep;
+} rotatedDrawing;
+
+#define ROTATED_DRAWING(rotation) { \
+        readPixelRotated<rotation>, plotPixelRotated<rotation>, \
+        drawFastHLineRotated<rotation>, drawFastVLineRotated<rotation>, \
+        drawLineRotated<rotation>, drawPolylineRotated<rotation>, drawCircleRotated<rotation>, \
+        fillCircleRotated<rotation>, fillCircleRotated<rotation>, \
+        drawEllipseRotated<rotation>, fillRectangleRotated<rotation>, \
+        markDirtyRotated<rotation>, \
+        rotationMap<rotation>::origin, rotationMap<rotation>::xStep, rotationMap<rotation>::yStep \
+    }
 
-    for (i = 0; i <= dx1; i++)
-    {
-        drawFastHLine(t1x, t2x, t1y, color);
+// order needs to match rotationDegrees enum
+static const rotatedDrawing rotatedDrawingTable[] = {
+    ROTATED_DRAWING(rotation0),
+    ROTATED_DRAWING(rotation90),
+    ROTATED_DRAWING(rotation180),
+    ROTATED_DRAWING(rotation270),
+};
+
+static const rotatedDrawing *drawing = &rotatedDrawingTable[rotation0];
+
+void SmartMatrix::selectRotatedDrawing(void) {
+    drawing = &rotatedDrawingTable[screenConfig.rotation];
+
+    // local coordinates of anything changed so far are meaningless after the rotation changes
+    if (dirtyLocalValid) {
+        dirtyLocalX0 = 0;
+        dirtyLocalY0 = 0;
+        dirtyLocalX1 = screenConfig.localWidth - 1;
+        dirtyLocalY1 = screenConfig.localHeight - 1;
+    }
 
-        while (dx1 > 0 && e1 >= 0)
-        {
-            if (changed1)
-                t1x += signx1;
-            else
-                t1y += signy1;
-            e1 = e1 - 2 * dx1;
-        }
+#if BACKGROUND_LOCAL_COORDINATES
+    // buffer rows change length with the rotation, and the contents have to be redrawn anyway
+    clearDirtyRegion(&drawnRegion);
+    for (int i = 0; i < BACKGROUND_BUFFERS; i++)
+        clearDirtyRegion(&staleRegion[i]);
+    dirtyRowWidth = screenConfig.localWidth;
+    markAllDirty();
+#endif
+}
 
-        if (changed1)
-            t1y += signy1;
-        else
-            t1x += signx1;
+void SmartMatrix::markAllDirty(void) {
+    drawing->markDirty(0, 0, screenConfig.localWidth - 1, screenConfig.localHeight - 1);
+}
 
-        e1 = e1 + 2 * dy1;
+// bounding rectangle of the spans in region mapped back to local coordinates, false if the region is empty
+static bool getRegionRect(const dirtyRegion *region, int16_t &x0, int16_t &y0, int16_t &x1, int16_t &y1) {
+    int row0 = -1, row1 = 0, column0 = dirtyRowWidth, column1 = 0;
 
-        /* here we rendered the next point on line 1 so follow now line 2
-         * until we are on the same y-value as line 1.
-         */
-        while (t2y != t1y)
-        {
-            while (dx2 > 0 && e2 >= 0)
-            {
-                if (changed2)
-                    t2x += signx2;
-                else
-                    t2y += signy2;
-                e2 = e2 - 2 * dx2;
-            }
+    for (int i = 0; i < DIRTY_ROWS; i++) {
+        if (!region->end[i])
+            continue;
 
-            if (changed2)
-                t2y += signy2;
-            else
-                t2x += signx2;
+        if (row0 < 0)
+            row0 = i;
+        row1 = i;
+        if (region->start[i] < column0) column0 = region->start[i];
+        if (region->end[i] > column1) column1 = region->end[i];
+    }
 
-            e2 = e2 + 2 * dy2;
-        }
+    if (row0 < 0)
+        return false;
+    column1--;
+
+    // one local direction steps through columns of a buffer row, the other through rows, each by +/-1
+    int originRow = drawing->origin / dirtyRowWidth;
+    int originColumn = drawing->origin % dirtyRowWidth;
+    int ax, ay, bx, by;
+
+    if (drawing->xStep == 1 || drawing->xStep == -1) {
+        int rowStep = drawing->yStep / dirtyRowWidth;
+        ax = (column0 - originColumn) * drawing->xStep;
+        bx = (column1 - originColumn) * drawing->xStep;
+        ay = (row0 - originRow) * rowStep;
+        by = (row1 - originRow) * rowStep;
+    } else {
+        int rowStep = drawing->xStep / dirtyRowWidth;
+        ax = (row0 - originRow) * rowStep;
+        bx = (row1 - originRow) * rowStep;
+        ay = (column0 - originColumn) * drawing->yStep;
+        by = (column1 - originColumn) * drawing->yStep;
     }
+
+    x0 = (ax < bx) ? ax : bx;
+    x1 = (ax < bx) ? bx : ax;
+    y0 = (ay < by) ? ay : by;
+    y1 = (ay < by) ? by : ay;
+    return true;
 }
 
-// Code from http://www.sunshine2k.de/coding/java/TriangleRasterization/TriangleRasterization.html
-void SmartMatrix::fillTriangle(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3, const rgb24& fillColor) {
-    // Sort vertices
-    if (y1 > y2) {
-        SWAPint(y1, y2);
-        SWAPint(x1, x2);
+// drawing continues after a swap without copy: what was drawn before it still differs from the last copied frame
+static void keepDrawnRect(void) {
+    int16_t x0, y0, x1, y1;
+
+    if (getRegionRect(&drawnRegion, x0, y0, x1, y1))
+        markDirtyLocal(x0, y0, x1, y1);
+}
+
+bool SmartMatrix::getDirtyRect(int16_t &x0, int16_t &y0, int16_t &x1, int16_t &y1) const {
+    if (!getRegionRect(&drawnRegion, x0, y0, x1, y1)) {
+        if (!dirtyLocalValid)
+            return false;
+
+        x0 = dirtyLocalX0;
+        y0 = dirtyLocalY0;
+        x1 = dirtyLocalX1;
+        y1 = dirtyLocalY1;
+        return true;
     }
-    if (y1 > y3) {
-        SWAPint(y1, y3);
-        SWAPint(x1, x3);
+
+    if (dirtyLocalValid) {
+        if (dirtyLocalX0 < x0) x0 = dirtyLocalX0;
+        if (dirtyLocalY0 < y0) y0 = dirtyLocalY0;
+        if (dirtyLocalX1 > x1) x1 = dirtyLocalX1;
+        if (dirtyLocalY1 > y1) y1 = dirtyLocalY1;
     }
-    if (y2 > y3) {
-        SWAPint(y2, y3);
-        SWAPint(x2, x3);
+    return true;
+}
+
+// reads pixel from drawing buffer, not refresh buffer
+bgcolor_t SmartMatrix::readPixel(int16_t x, int16_t y) const {
+    return drawing->readPixel(x, y);
+}
+
+void SmartMatrix::drawPixel(int16_t x, int16_t y, const bgcolor_t& color) {
+    drawing->plotPixel(x, y, color);
+}
+
+void SmartMatrix::drawFastHLine(int16_t x0, int16_t x1, int16_t y, const bgcolor_t& color) {
+    drawing->markDirty(x0, y, x1, y);
+    drawing->drawFastHLine(x0, x1, y, color);
+}
+
+void SmartMatrix::drawFastVLine(int16_t x, int16_t y0, int16_t y1, const bgcolor_t& color) {
+    drawing->markDirty(x, y0, x, y1);
+    drawing->drawFastVLine(x, y0, y1, color);
+}
+
+void SmartMatrix::drawLine(int16_t x1, int16_t y1, int16_t x2, int16_t y2, const bgcolor_t& color) {
+    drawing->markDirty(x1, y1, x2, y2);
+    drawing->drawLine(x1, y1, x2, y2, color);
+}
+
+// bounding rectangle of a list of points, for marking what connected lines or a polygon change
+static void markDirtyPoints(const int16_t x[], const int16_t y[], uint8_t numPoints) {
+    if (!numPoints)
+        return;
+
+    int16_t left = x[0], right = x[0], top = y[0], bottom = y[0];
+    for (int i = 1; i < numPoints; i++) {
+        if (x[i] < left) left = x[i];
+        if (x[i] > right) right = x[i];
+        if (y[i] < top) top = y[i];
+        if (y[i] > bottom) bottom = y[i];
     }
+    drawing->markDirty(left, top, right, bottom);
+}
 
-    if (y2 == y3)
-    {
-        fillFlatSideTriangleInt(x1, y1, x2, y2, x3, y3, fillColor);
+void SmartMatrix::drawPolyline(const int16_t x[], const int16_t y[], uint8_t numPoints, const bgcolor_t& color) {
+    markDirtyPoints(x, y, numPoints);
+    drawing->drawPolyline(x, y, numPoints, false, color);
+}
+
+void SmartMatrix::drawPolygon(const int16_t x[], const int16_t y[], uint8_t numPoints, const bgcolor_t& color) {
+    markDirtyPoints(x, y, numPoints);
+    drawing->drawPolyline(x, y, numPoints, true, color);
+}
+
+void SmartMatrix::drawCircle(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& color) {
+    drawing->markDirty(x0 - radius, y0 - radius, x0 + radius, y0 + radius);
+    drawing->drawCircle(x0, y0, radius, color);
+}
+
+void SmartMatrix::fillCircle(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& outlineColor, const bgcolor_t& fillColor) {
+    drawing->markDirty(x0 - radius, y0 - radius, x0 + radius, y0 + radius);
+    drawing->fillCircleOutlined(x0, y0, radius, outlineColor, fillColor);
+}
+
+void SmartMatrix::fillCircle(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& fillColor) {
+    drawing->markDirty(x0 - radius, y0 - radius, x0 + radius, y0 + radius);
+    drawing->fillCircle(x0, y0, radius, fillColor);
+}
+
+void SmartMatrix::drawEllipse(int16_t x0, int16_t y0, uint16_t radiusX, uint16_t radiusY, const bgcolor_t& color) {
+    drawing->markDirty(x0 - radiusX, y0 - radiusY, x0 + radiusX, y0 + radiusY);
+    drawing->drawEllipse(x0, y0, radiusX, radiusY, color);
+}
+
+void SmartMatrix::fillRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const bgcolor_t& color) {
+    drawing->markDirty(x0, y0, x1, y1);
+    drawing->fillRectangle(x0, y0, x1, y1, color);
+}
+
+void SmartMatrix::fillTriangle(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3, const bgcolor_t& fillColor) {
+    const int16_t x[] = { x1, x2, x3 };
+    const int16_t y[] = { y1, y2, y3 };
+
+    fillPolygon(x, y, 3, fillColor);
+}
+
+// one polygon edge in the edge table, oriented top to bottom, the exact x where it crosses the
+// current row is x + error / dy with 0 <= error < dy, so stepping rows needs no division or float
+typedef struct polygonEdge {
+    int32_t x;
+    int32_t error;
+    int32_t xStep;
+    int32_t errorStep;
+    int32_t dy;
+    int16_t yStart;                 // first row crossed
+    int16_t yEnd;                   // first row below the edge
+    int8_t winding;                 // +1 going down, -1 going up
+} polygonEdge;
+
+// first column at or right of where the edge crosses the current row
+static inline int32_t polygonEdgeColumn(const polygonEdge *edge) {
+    return edge->x + (edge->error > 0);
+}
+
+// Scanline fill using an active edge table, pixel (x, y) is filled when the point (x, y) is inside the
+// polygon by the nonzero winding rule, so concave and self-overlapping polygons fill solid.  Points
+// exactly on a top or left edge are inside and on a bottom or right edge are outside, polygons sharing
+// an edge never both fill it or leave a gap, and every filled row is drawn as a single horizontal span
+void SmartMatrix::fillPolygon(const int16_t x[], const int16_t y[], uint8_t numPoints, const bgcolor_t& fillColor) {
+    polygonEdge edges[SMART_MATRIX_POLYGON_MAX_POINTS];
+    polygonEdge *active[SMART_MATRIX_POLYGON_MAX_POINTS];
+    int numEdges = 0, numActive = 0, nextEdge = 0;
+    int i, j;
+
+    if (numPoints < 3 || numPoints > SMART_MATRIX_POLYGON_MAX_POINTS)
+        return;
+
+    int16_t left = x[0], right = x[0], top = y[0], bottom = y[0];
+    for (i = 1; i < numPoints; i++) {
+        if (x[i] < left) left = x[i];
+        if (x[i] > right) right = x[i];
+        if (y[i] < top) top = y[i];
+        if (y[i] > bottom) bottom = y[i];
     }
-    /* check for trivial case of top-flat triangle */
-    else if (y1 == y2)
-    {
-        fillFlatSideTriangleInt(x3, y3, x1, y1, x2, y2, fillColor);
+    drawing->markDirty(left, top, right, bottom);
+
+    // rows sampled, the bottom row of the polygon is on its bottom edges so is never filled
+    int16_t yFirst = (top < 0) ? 0 : top;
+    int16_t yLast = (bottom > screenConfig.localHeight) ? screenConfig.localHeight - 1 : bottom - 1;
+    if (yFirst > yLast || left >= screenConfig.localWidth || right < 0)
+        return;
+
+    // build the edge table sorted by first row, horizontal edges and edges outside the rows are left out
+    for (i = 0; i < numPoints; i++) {
+        j = (i + 1 < numPoints) ? i + 1 : 0;
+        if (y[i] == y[j])
+            continue;
+
+        polygonEdge edge;
+        int16_t xTop, yTop, yBottom;
+        if (y[i] < y[j]) {
+            xTop = x[i]; yTop = y[i]; yBottom = y[j];
+            edge.winding = 1;
+        } else {
+            xTop = x[j]; yTop = y[j]; yBottom = y[i];
+            edge.winding = -1;
+        }
+        if (yBottom <= yFirst || yTop > yLast)
+            continue;
+
+        int32_t dx = (edge.winding > 0) ? x[j] - x[i] : x[i] - x[j];
+        edge.dy = yBottom - yTop;
+        edge.yEnd = yBottom;
+        edge.yStart = (yTop < yFirst) ? yFirst : yTop;
+
+        // floored division so error stays positive for edges going left
+        edge.xStep = dx / edge.dy;
+        edge.errorStep = dx - edge.xStep * edge.dy;
+        if (edge.errorStep < 0) {
+            edge.xStep--;
+            edge.errorStep += edge.dy;
+        }
+
+        // an edge clipped at the top starts part way along, the offset can exceed 32 bits before dividing
+        int64_t offset = (int64_t)(edge.yStart - yTop) * dx;
+        int32_t whole = (int32_t)(offset / edge.dy);
+        int32_t error = (int32_t)(offset - (int64_t)whole * edge.dy);
+        if (error < 0) {
+            whole--;
+            error += edge.dy;
+        }
+        edge.x = xTop + whole;
+        edge.error = error;
+
+        for (j = numEdges; j > 0 && edges[j - 1].yStart > edge.yStart; j--)
+            edges[j] = edges[j - 1];
+        edges[j] = edge;
+        numEdges++;
     }
-    else
-    {
-        /* general case - split the triangle in a topflat and bottom-flat one */
-        int16_t xtmp, ytmp;
-        xtmp = (int)(x1 + ((float)(y2 - y1) / (float)(y3 - y1)) * (x3 - x1));
-        ytmp = y2;
-        fillFlatSideTriangleInt(x1, y1, x2, y2, xtmp, ytmp, fillColor);
-        fillFlatSideTriangleInt(x3, y3, x2, y2, xtmp, ytmp, fillColor);
+
+    for (int16_t row = yFirst; row <= yLast; row++) {
+        // retire edges that ended above this row, then add the ones starting on it
+        for (i = 0, j = 0; i < numActive; i++) {
+            if (active[i]->yEnd > row)
+                active[j++] = active[i];
+        }
+        numActive = j;
+        while (nextEdge < numEdges && edges[nextEdge].yStart == row)
+            active[numActive++] = &edges[nextEdge++];
+
+        // keep the active edges in column order, they only swap places where edges cross so this is nearly sorted
+        for (i = 1; i < numActive; i++) {
+            polygonEdge *edge = active[i];
+            int32_t column = polygonEdgeColumn(edge);
+            for (j = i; j > 0 && polygonEdgeColumn(active[j - 1]) > column; j--)
+                active[j] = active[j - 1];
+            active[j] = edge;
+        }
+
+        // fill from where the winding number leaves zero up to the column before it returns to zero
+        int winding = 0;
+        int32_t spanStart = 0;
+        for (i = 0; i < numActive; i++) {
+            int32_t column = polygonEdgeColumn(active[i]);
+            if (!winding)
+                spanStart = column;
+            winding += active[i]->winding;
+            if (!winding && column > spanStart) {
+                int32_t spanEnd = column - 1;
+                if (spanStart < 0)
+                    spanStart = 0;
+                if (spanEnd >= screenConfig.localWidth)
+                    spanEnd = screenConfig.localWidth - 1;
+                if (spanStart <= spanEnd)
+                    drawing->drawFastHLine(spanStart, spanEnd, row, fillColor);
+            }
+        }
+
+        for (i = 0; i < numActive; i++) {
+            polygonEdge *edge = active[i];
+            edge->x += edge->xStep;
+            edge->error += edge->errorStep;
+            if (edge->error >= edge->dy) {
+                edge->x++;
+                edge->error -= edge->dy;
+            }
+        }
     }
 }
 
 void SmartMatrix::fillTriangle(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3,
-  const rgb24& outlineColor, const rgb24& fillColor) {
+  const bgcolor_t& outlineColor, const bgcolor_t& fillColor) {
     fillTriangle(x1, y1, x2, y2, x3, y3, fillColor);
     drawTriangle(x1, y1, x2, y2, x3, y3, outlineColor);
 }
 
-void SmartMatrix::drawTriangle(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3, const rgb24& color) {
-    drawLine(x1, y1, x2, y2, color);
-    drawLine(x2, y2, x3, y3, color);
-    drawLine(x1, y1, x3, y3, color);
+void SmartMatrix::drawTriangle(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3, const bgcolor_t& color) {
+    const int16_t x[] = { x1, x2, x3 };
+    const int16_t y[] = { y1, y2, y3 };
+
+    drawPolygon(x, y, 3, color);
 }
 
-void SmartMatrix::drawRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const rgb24& color) {
+void SmartMatrix::drawRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const bgcolor_t& color) {
     drawFastHLine(x0, x1, y0, color);
     drawFastHLine(x0, x1, y1, color);
     drawFastVLine(x0, y0, y1, color);
     drawFastVLine(x1, y0, y1, color);
 }
 
-void SmartMatrix::fillRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const rgb24& color) {
-    int i;
-// Loop only works if y1 > y0
-    if (y0 > y1) {
-        SWAPint(y0, y1);
-    };
-// Putting the x coordinates in order saves multiple swaps in drawFastHLine
-    if (x0 > x1) {
-        SWAPint(x0, x1);
-    };
-
-    for (i = y0; i <= y1; i++) {
-        drawFastHLine(x0, x1, i, color);
-    }
-}
-
-void SmartMatrix::fillScreen(const rgb24& color) {
-    fillRectangle(0, 0, screenConfig.localWidth, screenConfig.localHeight, color);
+void SmartMatrix::fillScreen(const bgcolor_t& color) {
+    fillRectangle(0, 0, screenConfig.localWidth - 1, screenConfig.localHeight - 1, color);
 }
 
-void SmartMatrix::fillRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const rgb24& outlineColor, const rgb24& fillColor) {
+void SmartMatrix::fillRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const bgcolor_t& outlineColor, const bgcolor_t& fillColor) {
     fillRectangle(x0, y0, x1, y1, fillColor);
     drawRectangle(x0, y0, x1, y1, outlineColor);
 }
@@ -730,34 +1476,71 @@ void SmartMatrix::setFont(fontChoices newFont) {
     font = (bitmap_font *)fontLookup(newFont);
 }
 
-void SmartMatrix::drawChar(int16_t x, int16_t y, const rgb24& charColor, char character) {
-    int xcnt, ycnt;
+// draws one character of the current font, backColor is NULL for a transparent background
+// the glyph rectangle is clipped and the rotation resolved once, then each font row is written
+// along the hardware buffer with fixed pointer steps instead of going through drawPixel
+void SmartMatrix::drawGlyph(int16_t x, int16_t y, int location, const bgcolor_t& charColor, const bgcolor_t *backColor) {
+    int x0 = 0, x1 = font->Width;
+    int y0 = 0, y1 = font->Height;
+
+    // clip glyph to the screen, drawing columns x0 to x1-1 and rows y0 to y1-1 of the glyph
+    if (x < 0)
+        x0 = -x;
+    if (y < 0)
+        y0 = -y;
+    if (x + x1 > screenConfig.localWidth)
+        x1 = screenConfig.localWidth - x;
+    if (y + y1 > screenConfig.localHeight)
+        y1 = screenConfig.localHeight - y;
+
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    // nothing to draw for a transparent character that isn't in the font, font rows are a single byte
+    if (!backColor && (location < 0 || x0 >= 8))
+        return;
+
+    drawing->markDirty(x + x0, y + y0, x + x1 - 1, y + y1 - 1);
+
+    // top left pixel in the hardware buffer, and the steps for each local column and row
+    const int xStep = drawing->xStep;
+    const int yStep = drawing->yStep;
+    bgcolor_t *rowStart = &currentDrawBufferPtr[0][0] + drawing->origin + ((x + x0) * xStep) + ((y + y0) * yStep);
+    const unsigned char *glyphRow = (location < 0) ? NULL : &font->Bitmap[(location * font->Height) + y0];
+
+    if (backColor) {
+        for (int ycnt = y0; ycnt < y1; ycnt++, rowStart += yStep) {
+            // font row with column x0 in the MSB, columns past the glyph bitmap shift in as background
+            uint32_t bits = (glyphRow && x0 < 8) ? (uint32_t)glyphRow[ycnt - y0] << (24 + x0) : 0;
+            bgcolor_t *pixel = rowStart;
 
-    for (ycnt = 0; ycnt < font->Height; ycnt++) {
-        for (xcnt = 0; xcnt < font->Width; xcnt++) {
-            if (getBitmapFontPixelAtXY(character, xcnt, ycnt, font)) {
-                drawPixel(x + xcnt, y + ycnt, charColor);
+            for (int xcnt = x0; xcnt < x1; xcnt++, pixel += xStep, bits <<= 1)
+                *pixel = (bits & 0x80000000) ? charColor : *backColor;
+        }
+    } else {
+        uint32_t columnMask = (0xffffffff >> x0) & ~(0xffffffff >> (x1 < 8 ? x1 : 8));
+
+        for (int ycnt = y0; ycnt < y1; ycnt++, rowStart += yStep) {
+            uint32_t bits = ((uint32_t)glyphRow[ycnt - y0] << 24) & columnMask;
+
+            // only visit the set pixels, each count of leading zeros is the column of the next one
+            while (bits) {
+                int column = __builtin_clz(bits);
+                rowStart[(column - x0) * xStep] = charColor;
+                bits ^= 0x80000000 >> column;
             }
         }
     }
 }
 
-void SmartMatrix::drawString(int16_t x, int16_t y, const rgb24& charColor, const char *text) {
-    int xcnt, ycnt, location;
-    char character;
+void SmartMatrix::drawChar(int16_t x, int16_t y, const bgcolor_t& charColor, char character) {
+    drawGlyph(x, y, getBitmapFontLocation(character, font), charColor, NULL);
+}
 
+void SmartMatrix::drawString(int16_t x, int16_t y, const bgcolor_t& charColor, const char *text) {
     while(*text != '\0' && *text != '\n') {
-        character = *text;
+        drawGlyph(x, y, getBitmapFontLocation(*text, font), charColor, NULL);
         ++text;
-
-        location = getBitmapFontLocation(character, font);
-        for (ycnt = 0; ycnt < font->Height; ycnt++) {
-            for (xcnt = 0; xcnt < font->Width; xcnt++) {
-                if (getBitmapFontPixelAtXY(location, xcnt, ycnt, font)) {
-                    drawPixel(x + xcnt, y + ycnt, charColor);
-                }
-            }
-        }
         x += font->Width;
 
         if(x >= screenConfig.localWidth)
@@ -766,24 +1549,10 @@ void SmartMatrix::drawString(int16_t x, int16_t y, const rgb24& charColor, const
 }
 
 // draw string while clearing background
-void SmartMatrix::drawString(int16_t x, int16_t y, const rgb24& charColor, const rgb24& backColor, const char *text) {
-    int xcnt, ycnt, location;
-    char character;
-
+void SmartMatrix::drawString(int16_t x, int16_t y, const bgcolor_t& charColor, const bgcolor_t& backColor, const char *text) {
     while(*text != '\0' && *text != '\n') {
-        character = *text;
+        drawGlyph(x, y, getBitmapFontLocation(*text, font), charColor, &backColor);
         ++text;
-
-        location = getBitmapFontLocation(character, font);
-        for (ycnt = 0; ycnt < font->Height; ycnt++) {
-            for (xcnt = 0; xcnt < font->Width; xcnt++) {
-                if (getBitmapFontPixelAtXY(location, xcnt, ycnt, font)) {
-                    drawPixel(x + xcnt, y + ycnt, charColor);
-                } else {
-                    drawPixel(x + xcnt, y + ycnt, backColor);
-                }
-            }
-        }
         x += font->Width;
 
         if(x >= screenConfig.localWidth)
@@ -792,7 +1561,7 @@ void SmartMatrix::drawString(int16_t x, int16_t y, const rgb24& charColor, const
 }
 
 void SmartMatrix::drawMonoBitmap(int16_t x, int16_t y, uint8_t width, uint8_t height,
-  const rgb24& bitmapColor, const uint8_t *bitmap) {
+  const bgcolor_t& bitmapColor, const uint8_t *bitmap) {
     int xcnt, ycnt;
 
     for (ycnt = 0; ycnt < height; ycnt++) {
@@ -805,9 +1574,60 @@ void SmartMatrix::drawMonoBitmap(int16_t x, int16_t y, uint8_t width, uint8_t he
 }
 
 
-void SmartMatrix::handleBufferSwap(void) {
-    if (!swapPending)
-        return;
+#if BACKGROUND_BUFFERS > 2
+// called by the refresh once per frame, switches to the newest completed frame if there is one and it's due
+bool SmartMatrix::handleBufferSwap(uint32_t refreshFrame) {
+    uint8_t ready = __atomic_load_n(&readyBuffer, __ATOMIC_ACQUIRE);
+
+    if (!(ready & READY_FRAME) || (int32_t)(refreshFrame - bufferTargetFrame[ready & ~READY_FRAME]) < 0)
+        return false;
+
+    // the buffer refreshed so far goes back to the application, unless a newer frame replaced the one checked
+    if (!__atomic_compare_exchange_n(&readyBuffer, &ready, currentRefreshBuffer, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return false;
+
+    currentRefreshBuffer = ready & ~READY_FRAME;
+    currentRefreshBufferPtr = backgroundBuffer[currentRefreshBuffer];
+
+#if BACKGROUND_LOCAL_COORDINATES
+    refreshRotation = bufferRotation[currentRefreshBuffer];
+#endif
+
+    return true;
+}
+
+// hands the drawing buffer to the refresh and continues in a free buffer without waiting for the refresh,
+// unless swapInOrder is set and the last completed frame hasn't been refreshed yet
+void SmartMatrix::swapBuffersAt(uint32_t refreshFrame, bool copy) {
+    unsigned char completedBuffer = currentDrawBuffer;
+
+    bufferTargetFrame[completedBuffer] = refreshFrame;
+#if BACKGROUND_LOCAL_COORDINATES
+    bufferRotation[completedBuffer] = screenConfig.rotation;
+#endif
+    if (!copy)
+        keepDrawnRect();
+    completeDrawnRegion(completedBuffer);
+
+    if (swapMode == swapInOrder)
+        while (__atomic_load_n(&readyBuffer, __ATOMIC_ACQUIRE) & READY_FRAME);
+
+    // get back the buffer the refresh returned, or the completed frame it hasn't picked up yet
+    currentDrawBuffer = __atomic_exchange_n(&readyBuffer, completedBuffer | READY_FRAME, __ATOMIC_ACQ_REL) & ~READY_FRAME;
+    currentDrawBufferPtr = backgroundBuffer[currentDrawBuffer];
+
+    // the completed frame is only read by the refresh, it can be copied from while it's shown
+    if (copy) {
+        copyDirtyRegion(&currentDrawBufferPtr[0][0], &backgroundBuffer[completedBuffer][0][0], &staleRegion[currentDrawBuffer]);
+        dirtyLocalValid = false;
+    } else {
+        keepStaleRegion(currentDrawBuffer);
+    }
+}
+#else
+bool SmartMatrix::handleBufferSwap(uint32_t refreshFrame) {
+    if (!swapPending || (int32_t)(refreshFrame - swapTargetFrame) < 0)
+        return false;
 
     unsigned char newDrawBuffer = currentRefreshBuffer;
 
@@ -817,30 +1637,66 @@ void SmartMatrix::handleBufferSwap(void) {
     currentRefreshBufferPtr = backgroundBuffer[currentRefreshBuffer];
     currentDrawBufferPtr = backgroundBuffer[currentDrawBuffer];
 
+#if BACKGROUND_LOCAL_COORDINATES
+    refreshRotation = screenConfig.rotation;
+#endif
+
     swapPending = false;
+    return true;
 }
 
-// waits until swap is complete before returning
-void SmartMatrix::swapBuffers(bool copy) {
+// waits until swap is complete before returning, drawing can only continue once the frame is swapped out
+// so this also waits for a later refresh frame, a swap without copy in the next frame returns right away
+void SmartMatrix::swapBuffersAt(uint32_t refreshFrame, bool copy) {
     while (swapPending);
 
+    unsigned char newDrawBuffer = currentRefreshBuffer;
+    if (!copy)
+        keepDrawnRect();
+    completeDrawnRegion(currentDrawBuffer);
+
+    swapTargetFrame = refreshFrame;
     swapPending = true;
 
-    if (copy) {
+    if (copy || (int32_t)(refreshFrame - getRefreshFrameCount()) > 1)
         while (swapPending);
-        memcpy(currentDrawBufferPtr, currentRefreshBufferPtr, sizeof(backgroundBuffer[0]));
+
+    // only the region where the buffers differ is copied, without a copy it keeps growing
+    if (copy) {
+        copyDirtyRegion(&currentDrawBufferPtr[0][0], &currentRefreshBufferPtr[0][0], &staleRegion[newDrawBuffer]);
+        dirtyLocalValid = false;
+    } else {
+        keepStaleRegion(newDrawBuffer);
     }
 }
+#endif
+
+// swap in the next refresh frame
+void SmartMatrix::swapBuffers(bool copy) {
+    swapBuffersAt(getRefreshFrameCount(), copy);
+}
+
+void SmartMatrix::setSwapMode(swapModes mode) {
+#if BACKGROUND_BUFFERS > 2
+    swapMode = mode;
+#else
+    (void)mode;
+#endif
+}
 
 // return pointer to start of currentDrawBuffer, so application can do efficient loading of bitmaps
-rgb24 *SmartMatrix::backBuffer(void) {
+// anything could be written through it, so the whole buffer is copied after the next swap
+bgcolor_t *SmartMatrix::backBuffer(void) {
+    markAllDirty();
     return currentDrawBufferPtr[0];
 }
 
-void SmartMatrix::setBackBuffer(rgb24 *newBuffer) {
-  currentDrawBufferPtr = (rgb24 (*)[MATRIX_WIDTH])newBuffer;
+void SmartMatrix::setBackBuffer(bgcolor_t *newBuffer) {
+  markAllDirty();
+  currentDrawBufferPtr = (bgcolor_t (*)[MATRIX_WIDTH])newBuffer;
 }
 
-rgb24 *SmartMatrix::getRealBackBuffer() {
+bgcolor_t *SmartMatrix::getRealBackBuffer() {
+  markAllDirty();
   return &backgroundBuffer[currentDrawBuffer][0][0];
 }
@@ -35,10 +35,15 @@
 // only 24-bit color supported
 #define COLOR_DEPTH_RGB             24
 // DMA_BUFFER_NUMBER_OF_ROWS = the size of the buffer that DMA pulls from to refresh the display
-// must be minimum 2 rows so one can be updated while the otehr is refreshed
+// must be minimum 2 rows so one can be updated while the otehr is refreshed, and a power of two
 // increase beyond two to give more time for the update routine to complete
 // (increase this number if non-DMA interrupts are causing display problems)
 #define DMA_BUFFER_NUMBER_OF_ROWS   4
+// STATIC_FRAME_REFRESH = 1 packs the whole frame into DMA buffers once per change instead of once per row,
+// the refresh interrupt then only steps through the packed rows, leaving the CPU free when the image is static
+// costs two packed frames of RAM in place of DMA_BUFFER_NUMBER_OF_ROWS rows: (MATRIX_HEIGHT/2) rows *
+// (MATRIX_WIDTH * COLOR_DEPTH_RGB/3 * 2 bytes + COLOR_DEPTH_RGB/3 * 8 bytes) per frame, 4.5KB per frame, 9KB total here
+#define STATIC_FRAME_REFRESH        0
 // size of latch pulse - all address updates must fit inside high portion of latch pulse
 // increase this value if DMA use is causing address updates to take longer
 #define LATCH_TIMER_PULSE_WIDTH_NS  438
@@ -46,6 +51,25 @@
 // look for the last clock pulse after the latch.  set the min block period to be beyond this last pulse
 // default (10us) is a generous minimum that should work with all Teensy 3.x devices at 48MHz and above
 #define MIN_BLOCK_PERIOD_NS     10000
+// REFRESH_STATS_ENABLED = 1 measures the refresh interrupts and the code they call with the DWT cycle counter,
+// read the min/avg/max cycles with getRefreshStats() to check the headroom left before rows are late
+#define REFRESH_STATS_ENABLED       0
+// BACKGROUND_LOCAL_COORDINATES = 1 keeps the background buffers in the rotated orientation, row-major with
+// getScreenWidth() pixels per row, so drawing and loading backBuffer() is sequential in any rotation
+// the refresh remaps each row to the panel while packing it, redraw the background after changing rotation
+#define BACKGROUND_LOCAL_COORDINATES    0
+// BACKGROUND_BUFFERS = 3 adds a third background buffer so swapBuffers() hands the finished frame to the refresh
+// and returns without waiting for the refresh to pick it up, see setSwapMode(), costs 1.5KB more RAM here
+#define BACKGROUND_BUFFERS          2
+// BACKGROUND_INDEXED_COLOR = 1 stores background pixels as 8-bit indexes into a 256 color palette, see setPalette(),
+// background drawing functions then take a palette index as the color, saves 1KB of RAM per background buffer here
+#define BACKGROUND_INDEXED_COLOR    0
+// BACKGROUND_RGB565 = 1 stores background pixels in 16 bits as rgb16, 5 bits red, 6 bits green and 5 bits blue,
+// rgb24 colors given to the drawing functions are converted, saves 0.5KB of RAM per background buffer here
+#define BACKGROUND_RGB565           0
+// number of sprites drawn over the background during refresh, see setSprite(), each hardware row keeps a list
+// of the sprites on it so a row only costs the sprites that overlap it, costs about 0.4KB of RAM here
+#define MATRIX_SPRITES              8
 
 // set number of text scrollers. 2 for dual-line scroll capability and 4 for four-line scrolling capablity.
 #define MATRIX_SCROLLERS		2
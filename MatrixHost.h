@@ -0,0 +1,106 @@
+/*
+ * SmartMatrix Library - Host Platform Model of the Teensy 3.x Refresh Hardware
+ *
+ * Copyright (c) 2014 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+ // Note: only used when SMARTMATRIX_HOST is defined, takes the place of Arduino.h and DMAChannel.h
+ // build the library sources together with a host program, fonts are C sources, e.g.:
+ //   gcc -O2 -c Font_*.c
+ //   g++ -std=gnu++11 -O2 -DSMARTMATRIX_HOST -I. *.cpp Font_*.o myprogram.cpp -lpthread
+
+#ifndef MATRIX_HOST_H
+#define MATRIX_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// default bus clock of a Teensy 3.1 running at 96MHz, used to scale the latch timer model
+#ifndef F_BUS
+#define F_BUS   48000000
+#endif
+
+#define DMAMEM
+
+#define LOW     0
+#define HIGH    1
+#define OUTPUT  1
+
+static inline void pinMode(uint8_t, uint8_t) {}
+static inline void digitalWriteFast(uint8_t, uint8_t) {}
+static inline void noInterrupts(void) {}
+static inline void interrupts(void) {}
+
+// eDMA channel stand-in: only the source address is modeled, the refresh model reads
+// matrixUpdateBlocks and matrixUpdateData through it the same way the linked channels do
+class DMAChannel {
+public:
+    struct TCD_t {
+        volatile const void *SADDR;
+    };
+
+    DMAChannel(bool) : TCD(&tcd), channel(0) {}
+
+    TCD_t *TCD;
+    uint8_t channel;
+
+    void clearInterrupt(void) {}
+
+private:
+    TCD_t tcd;
+};
+
+// PORTA config register written by rowShiftCompleteISR to clear the pending latch interrupt
+extern volatile uint32_t CORE_PIN3_CONFIG;
+
+// the row calculation software interrupt is the only interrupt the ISRs pend
+#define IRQ_DMA_CH0             0
+#define NVIC_SET_PENDING(n)     matrixHostSetPending(n)
+
+void matrixHostSetPending(int irq);
+
+// free running nanosecond counter, takes the place of the DWT cycle counter for the refresh statistics
+#define MATRIX_HOST_CYCLES_PER_SECOND   1000000000
+uint32_t matrixHostGetCycleCount(void);
+
+// latch timer model
+// runs the refresh for the given number of rows: for every row the DMA stream is captured, then
+// rowShiftCompleteISR and the pended rowCalculationISR are called just like the hardware would
+void matrixHostRunRows(uint32_t rows);
+void matrixHostRunFrames(uint32_t frames);
+// runs the latch timer on its own thread so the application thread is preempted like on the Teensy
+// (needed by anything that waits on the ISR e.g. swapBuffers), realtime paces rows at MATRIX_REFRESH_RATE
+void matrixHostStartLatchTimer(bool realtime = false);
+void matrixHostStopLatchTimer(void);
+
+// number of complete frames refreshed, and elapsed F_BUS ticks according to the latch timer periods
+uint32_t matrixHostGetFrameCount(void);
+uint64_t matrixHostGetTicks(void);
+
+// stream captured from the last refresh of each row, in the order the DMA channels sent it:
+// the address pins, the FTM1 OE/period values loaded for each latch, and the bytes written to
+// GPIOD_PDOR for each latch (two per column, the second with the clock bit set)
+uint16_t matrixHostGetCapturedAddress(uint8_t row);
+void matrixHostGetCapturedTimer(uint8_t row, uint8_t latch, uint16_t *oe, uint16_t *period);
+const uint8_t *matrixHostGetCapturedData(uint8_t row, uint8_t latch);
+
+#endif
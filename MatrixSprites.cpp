@@ -0,0 +1,248 @@
+/*
+ * SmartMatrix Library - Methods for interacting with sprites
+ *
+ * Copyright (c) 2014 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "SmartMatrix.h"
+
+// sprite registers written by the application, copied for the refresh at the start of a frame
+// so a sprite never moves part way through a frame
+typedef struct spriteRegisters {
+    const bgcolor_t *bitmap;
+    int16_t x;
+    int16_t y;
+    uint8_t width;
+    uint8_t height;
+    uint8_t depth;
+    bool visible;
+    bool transparent;
+    bgcolor_t transparentColor;
+} spriteRegisters;
+
+static spriteRegisters sprites[MATRIX_SPRITES];
+static spriteRegisters refreshSprites[MATRIX_SPRITES];
+static volatile bool spriteUpdatePending = false;
+
+// sprites on each hardware row in drawing order, built when the sprites change
+static uint8_t rowSprites[MATRIX_HEIGHT][MATRIX_SPRITES];
+static uint8_t rowSpriteCount[MATRIX_HEIGHT];
+static rotationDegrees rowSpritesRotation = rotation0;
+
+
+// bitmap holds width x height pixels row by row in local coordinates, and the sprite is shown with its top left at (x, y)
+// NULL bitmap hides the sprite
+void SmartMatrix::setSprite(uint8_t index, const bgcolor_t *bitmap, uint8_t width, uint8_t height, int16_t x, int16_t y) {
+    if (index >= MATRIX_SPRITES)
+        return;
+
+    noInterrupts();
+    sprites[index].bitmap = bitmap;
+    sprites[index].width = width;
+    sprites[index].height = height;
+    sprites[index].x = x;
+    sprites[index].y = y;
+    sprites[index].visible = true;
+    spriteUpdatePending = true;
+    interrupts();
+}
+
+void SmartMatrix::moveSprite(uint8_t index, int16_t x, int16_t y) {
+    if (index >= MATRIX_SPRITES)
+        return;
+
+    noInterrupts();
+    sprites[index].x = x;
+    sprites[index].y = y;
+    spriteUpdatePending = true;
+    interrupts();
+}
+
+// sprites with a higher depth are drawn over ones with a lower depth, equal depths are drawn in index order
+void SmartMatrix::setSpriteDepth(uint8_t index, uint8_t depth) {
+    if (index >= MATRIX_SPRITES)
+        return;
+
+    noInterrupts();
+    sprites[index].depth = depth;
+    spriteUpdatePending = true;
+    interrupts();
+}
+
+void SmartMatrix::setSpriteVisible(uint8_t index, bool visible) {
+    if (index >= MATRIX_SPRITES)
+        return;
+
+    noInterrupts();
+    sprites[index].visible = visible;
+    spriteUpdatePending = true;
+    interrupts();
+}
+
+// sprite pixels of the transparent color show what's under the sprite
+void SmartMatrix::setSpriteTransparentColor(uint8_t index, const bgcolor_t& color, bool transparent) {
+    if (index >= MATRIX_SPRITES)
+        return;
+
+    noInterrupts();
+    sprites[index].transparentColor = color;
+    sprites[index].transparent = transparent;
+    spriteUpdatePending = true;
+    interrupts();
+}
+
+// called by the refresh once per frame, takes the sprites written since the last frame and rebuilds the row lists
+// returns true if the sprites changed
+bool SmartMatrix::handleSpriteUpdate(void) {
+    if (!spriteUpdatePending && rowSpritesRotation == screenConfig.rotation)
+        return false;
+
+    if (spriteUpdatePending) {
+        memcpy((uint8_t *)refreshSprites, (const uint8_t *)sprites, sizeof(refreshSprites));
+        spriteUpdatePending = false;
+    }
+    rowSpritesRotation = screenConfig.rotation;
+
+    // visible sprites in drawing order, sorted by depth
+    uint8_t order[MATRIX_SPRITES];
+    int count = 0;
+    for (int i = 0; i < MATRIX_SPRITES; i++) {
+        const spriteRegisters *sprite = &refreshSprites[i];
+        if (!sprite->visible || !sprite->bitmap || !sprite->width || !sprite->height)
+            continue;
+
+        int j = count++;
+        while (j > 0 && refreshSprites[order[j - 1]].depth > sprite->depth) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    memset(rowSpriteCount, 0x00, sizeof(rowSpriteCount));
+
+    for (int i = 0; i < count; i++) {
+        const spriteRegisters *sprite = &refreshSprites[order[i]];
+        int top, bottom;
+
+        // hardware rows covered by the sprite
+        switch (rowSpritesRotation) {
+        case rotation0:
+            top = sprite->y;
+            bottom = sprite->y + sprite->height - 1;
+            break;
+        case rotation90:
+            top = sprite->x;
+            bottom = sprite->x + sprite->width - 1;
+            break;
+        case rotation180:
+            top = MATRIX_HEIGHT - sprite->y - sprite->height;
+            bottom = MATRIX_HEIGHT - 1 - sprite->y;
+            break;
+        case rotation270:
+        default:
+            top = MATRIX_HEIGHT - sprite->x - sprite->width;
+            bottom = MATRIX_HEIGHT - 1 - sprite->x;
+            break;
+        }
+
+        if (top < 0)
+            top = 0;
+        if (bottom >= MATRIX_HEIGHT)
+            bottom = MATRIX_HEIGHT - 1;
+
+        for (int y = top; y <= bottom; y++)
+            rowSprites[y][rowSpriteCount[y]++] = order[i];
+    }
+
+    return true;
+}
+
+bool SmartMatrix::spritesOnRow(uint8_t hardwareY) {
+    return rowSpriteCount[hardwareY] != 0;
+}
+
+// draws the sprites on hardware row hardwareY over the background row into row, with a stride of one pixel
+// background can be row itself
+void SmartMatrix::loadSpriteRow(uint8_t hardwareY, bgcolor_t *row, const bgcolor_t *background, int backgroundStride) {
+    if (background != row) {
+        for (int i = 0; i < MATRIX_WIDTH; i++)
+            row[i] = background[i * backgroundStride];
+    }
+
+    int rowX, rowY, stepX, stepY;
+    getLocalRowPosition(hardwareY, &rowX, &rowY, &stepX, &stepY);
+
+    for (int k = 0; k < rowSpriteCount[hardwareY]; k++) {
+        const spriteRegisters *sprite = &refreshSprites[rowSprites[hardwareY][k]];
+        int position, step, start, end, offset, pitch;
+
+        // the row runs along one local axis and crosses the sprite at a fixed position on the other,
+        // offset is the bitmap index for that fixed position and pitch the bitmap step along the row's axis
+        if (!stepY) {
+            int spriteRow = rowY - sprite->y;
+            if (spriteRow < 0 || spriteRow >= sprite->height)
+                continue;
+
+            position = rowX;
+            step = stepX;
+            start = sprite->x;
+            end = sprite->x + sprite->width;
+            offset = spriteRow * sprite->width;
+            pitch = 1;
+        } else {
+            int spriteColumn = rowX - sprite->x;
+            if (spriteColumn < 0 || spriteColumn >= sprite->width)
+                continue;
+
+            position = rowY;
+            step = stepY;
+            start = sprite->y;
+            end = sprite->y + sprite->height;
+            offset = spriteColumn;
+            pitch = sprite->width;
+        }
+
+        // hardware columns where the position along the row is between start and end-1
+        int first, last;
+        if (step > 0) {
+            first = start - position;
+            last = end - position;
+        } else {
+            first = position - end + 1;
+            last = position - start + 1;
+        }
+        if (first < 0)
+            first = 0;
+        if (last > MATRIX_WIDTH)
+            last = MATRIX_WIDTH;
+
+        const bgcolor_t *pixel = sprite->bitmap + offset + (position + (first * step) - start) * pitch;
+        const int bitmapStep = step * pitch;
+
+        for (int i = first; i < last; i++) {
+            bgcolor_t color = *pixel;
+            if (!sprite->transparent || !(color == sprite->transparentColor))
+                row[i] = color;
+            pixel += bitmapStep;
+        }
+    }
+}
@@ -0,0 +1,142 @@
+/*
+ * SmartMatrix Library - Methods for interacting with tile layer
+ *
+ * Copyright (c) 2014 Louis Beaudoin (Pixelmatix)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "SmartMatrix.h"
+
+// tiles are 8x8 pixels, stored row by row one after the other
+#define TILE_SHIFT      3
+#define TILE_SIZE       (1 << TILE_SHIFT)
+#define TILE_MASK       (TILE_SIZE - 1)
+
+// layer registers written by the application, copied for the refresh at the start of a frame
+// so a scroll or page flip never takes effect part way through a frame
+typedef struct tileLayerRegisters {
+    const bgcolor_t *tiles;
+    const uint8_t *map;
+    uint8_t mapWidth;
+    uint8_t mapHeight;
+    int16_t scrollX;
+    int16_t scrollY;
+    bool transparent;
+    bgcolor_t transparentColor;
+} tileLayerRegisters;
+
+static tileLayerRegisters tileLayer;
+static tileLayerRegisters refreshTileLayer;
+static volatile bool tileLayerUpdatePending = false;
+
+
+// tiles holds 64 pixels per tile, map holds a tile number for each of mapWidth x mapHeight tiles, row by row
+// the layer wraps around at its edges, and NULL tiles turns it off
+void SmartMatrix::setTileLayer(const bgcolor_t *tiles, const uint8_t *map, uint8_t mapWidth, uint8_t mapHeight) {
+    noInterrupts();
+    tileLayer.tiles = tiles;
+    tileLayer.map = map;
+    tileLayer.mapWidth = mapWidth;
+    tileLayer.mapHeight = mapHeight;
+    tileLayerUpdatePending = true;
+    interrupts();
+}
+
+// switch to another map of the same size, e.g. to flip pages
+void SmartMatrix::setTileMap(const uint8_t *map) {
+    noInterrupts();
+    tileLayer.map = map;
+    tileLayerUpdatePending = true;
+    interrupts();
+}
+
+// position of the layer pixel shown at local screen coordinates (0,0)
+void SmartMatrix::setTileScroll(int16_t x, int16_t y) {
+    noInterrupts();
+    tileLayer.scrollX = x;
+    tileLayer.scrollY = y;
+    tileLayerUpdatePending = true;
+    interrupts();
+}
+
+// tile pixels of the transparent color show the background through the layer
+void SmartMatrix::setTileTransparentColor(const bgcolor_t& color, bool transparent) {
+    noInterrupts();
+    tileLayer.transparentColor = color;
+    tileLayer.transparent = transparent;
+    tileLayerUpdatePending = true;
+    interrupts();
+}
+
+// called by the refresh once per frame, returns true if the registers changed
+bool SmartMatrix::handleTileLayerUpdate(void) {
+    if (!tileLayerUpdatePending)
+        return false;
+
+    refreshTileLayer = tileLayer;
+    tileLayerUpdatePending = false;
+    return true;
+}
+
+// composes hardware row hardwareY of the layer over the background row into row, with a stride of one pixel
+// returns false without touching row if the layer is off
+bool SmartMatrix::loadTileLayerRow(uint8_t hardwareY, bgcolor_t *row, const bgcolor_t *background, int backgroundStride) {
+    const tileLayerRegisters *layer = &refreshTileLayer;
+
+    if (!layer->tiles || !layer->map || !layer->mapWidth || !layer->mapHeight)
+        return false;
+
+    const int layerWidth = layer->mapWidth * TILE_SIZE;
+    const int layerHeight = layer->mapHeight * TILE_SIZE;
+    int x, y, stepX, stepY;
+
+    getLocalRowPosition(hardwareY, &x, &y, &stepX, &stepY);
+
+    // position in the layer, wrapped once here and then only as it steps past an edge
+    x = (x + layer->scrollX) % layerWidth;
+    if (x < 0)
+        x += layerWidth;
+    y = (y + layer->scrollY) % layerHeight;
+    if (y < 0)
+        y += layerHeight;
+
+    for (int i = 0; i < MATRIX_WIDTH; i++) {
+        uint8_t tile = layer->map[(y >> TILE_SHIFT) * layer->mapWidth + (x >> TILE_SHIFT)];
+        bgcolor_t color = layer->tiles[(tile << (2 * TILE_SHIFT)) + ((y & TILE_MASK) << TILE_SHIFT) + (x & TILE_MASK)];
+
+        if (layer->transparent && color == layer->transparentColor)
+            color = background[i * backgroundStride];
+
+        row[i] = color;
+
+        x += stepX;
+        if (x >= layerWidth)
+            x = 0;
+        else if (x < 0)
+            x = layerWidth - 1;
+
+        y += stepY;
+        if (y >= layerHeight)
+            y = 0;
+        else if (y < 0)
+            y = layerHeight - 1;
+    }
+
+    return true;
+}
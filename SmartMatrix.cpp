@@ -22,8 +22,14 @@
  */
 
 #include "SmartMatrix.h"
-#include "CircularBuffer.h"
+#include "IndexRing.h"
+#ifndef SMARTMATRIX_HOST
 #include "DMAChannel.h"
+#else
+#include <atomic>
+#include <chrono>
+#include <thread>
+#endif
 
 #define INLINE __attribute__( ( always_inline ) ) inline
 
@@ -70,8 +76,37 @@ typedef struct matrixUpdateBlock {
     addresspair addressValues;
 } matrixUpdateBlock;
 
-static CircularBuffer dmaBuffer;
-static DMAMEM matrixUpdateBlock matrixUpdateBlocks[DMA_BUFFER_NUMBER_OF_ROWS][LATCHES_PER_ROW];
+#if STATIC_FRAME_REFRESH
+// two packed frames: one is refreshed while the other is packed
+#define DMA_BUFFER_ROWS     (2 * MATRIX_ROWS_PER_FRAME)
+#define STATIC_FRAME_ROW_BUFFER(frame, row)     ((frame) * MATRIX_ROWS_PER_FRAME + (row))
+
+static unsigned char staticFrameRefresh = 0;
+static unsigned char staticFrameRow = 0;
+static volatile bool staticFramePending = false;
+#else
+#define DMA_BUFFER_ROWS     DMA_BUFFER_NUMBER_OF_ROWS
+#endif
+
+static IndexRing<DMA_BUFFER_NUMBER_OF_ROWS> dmaBuffer;
+
+#if !STATIC_FRAME_REFRESH
+// frame and row loaded into each DMA buffer slot, for reporting underruns
+static uint32_t dmaBufferFrame[DMA_BUFFER_ROWS];
+static unsigned char dmaBufferRow[DMA_BUFFER_ROWS];
+#endif
+
+// number of the frame being loaded, counted when its once-per-frame updates run
+static volatile uint32_t refreshFrameCount = 0;
+static uint32_t reportedFrameCount = 0;
+static vsync_cb vsyncCallback = NULL;
+
+static volatile refresh_underruns refreshUnderruns;
+static uint32_t reportedUnderrunCount = 0;
+static uint32_t reportedLateRowCount = 0;
+static refresh_cb refreshEventCallback = NULL;
+
+static DMAMEM matrixUpdateBlock matrixUpdateBlocks[DMA_BUFFER_ROWS][LATCHES_PER_ROW];
 
 /*
   buffer contains:
@@ -80,7 +115,7 @@ static DMAMEM matrixUpdateBlock matrixUpdateBlocks[DMA_BUFFER_NUMBER_OF_ROWS][LA
       second half of the words have the same data, plus a high bit in each byte for the clock
     there are MATRIX_WIDTH number of these in order to refresh a row (pair of rows)
  */
-static DMAMEM uint32_t matrixUpdateData[DMA_BUFFER_NUMBER_OF_ROWS][MATRIX_WIDTH][(LATCHES_PER_ROW / sizeof(uint32_t)) * DMA_UPDATES_PER_CLOCK];
+static DMAMEM uint32_t matrixUpdateData[DMA_BUFFER_ROWS][MATRIX_WIDTH][(LATCHES_PER_ROW / sizeof(uint32_t)) * DMA_UPDATES_PER_CLOCK];
 
 #define ADDRESS_ARRAY_REGISTERS_TO_UPDATE   2
 static addresspair addressLUT[MATRIX_ROWS_PER_FRAME];
@@ -93,7 +128,93 @@ typedef struct gpiopair {
     uint32_t  gpio_pcor;
 } gpiopair;
 
+#ifndef SMARTMATRIX_HOST
+// staging area for the address DMA channels, not part of the host model
 static gpiopair gpiosync;
+#endif
+
+// this technique is from Fadecandy
+// order of bits in word matches how GPIO connects to the display
+typedef union {
+    uint32_t word;
+    struct {
+        uint32_t GPIO_WORD_ORDER;
+    };
+} gpioword;
+
+#define GPIO_WORDS_PER_CLOCK    ((int)(LATCHES_PER_ROW / sizeof(uint32_t)))
+
+// bit position of a signal inside each byte of a GPIO word, folds to a constant at compile time
+#define GPIO_BIT_POSITION(field) __extension__ ({ gpioword w; w.word = 0; w.field = 1; __builtin_ctz(w.word); })
+
+// moves bit n of the selected nibble to bit n*8, then shifts the result to the signal's position in each byte
+#define SPREAD_NIBBLE(value, nibble, bit) \
+    (((((uint32_t)(value) >> (4 * (nibble))) & 0x0F) * 0x00204081 & 0x01010101) << (bit))
+
+/*
+  color spread tables map an 8-bit color channel straight to the GPIO words for all bitplanes, with color correction applied
+    bits are spread to bit 0 of each byte, and get shifted to the channel's position when packing
+    table 0 is for foreground pixels, table 1 for background pixels
+  tables are double buffered: rebuilt outside of the ISR into the set not used by refresh, and switched at the start of a frame
+ */
+#define COLOR_SPREAD_FOREGROUND     0
+#define COLOR_SPREAD_BACKGROUND     1
+
+static uint32_t colorSpreadLUT[2][2][256][GPIO_WORDS_PER_CLOCK];
+static unsigned char colorSpreadRefreshSet = 0;
+static volatile bool colorSpreadSwapPending = false;
+static bool refreshStarted = false;
+
+#if BACKGROUND_INDEXED_COLOR
+// background palette, double buffered like the color spread tables, backgroundPaletteSet is the set last written
+static rgb24 backgroundPalette[2][256];
+static unsigned char paletteRefreshSet = 0;
+static unsigned char backgroundPaletteSet = 0;
+static volatile bool paletteSwapPending = false;
+#endif
+
+#if REFRESH_STATS_ENABLED
+typedef struct refreshTimingAccumulator {
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+} refreshTimingAccumulator;
+
+static struct {
+    refreshTimingAccumulator rowShiftCompleteISR;
+    refreshTimingAccumulator rowCalculationISR;
+    refreshTimingAccumulator loadMatrixBuffers;
+    refreshTimingAccumulator frameUpdate;
+    refreshTimingAccumulator bufferSwap;
+    refreshTimingAccumulator foregroundUpdate;
+    refreshTimingAccumulator colorTables;
+} refreshStats;
+
+#ifdef SMARTMATRIX_HOST
+#define REFRESH_STATS_CYCLES_PER_SECOND     MATRIX_HOST_CYCLES_PER_SECOND
+#define REFRESH_STATS_CYCLE_COUNT()         matrixHostGetCycleCount()
+#else
+#define REFRESH_STATS_CYCLES_PER_SECOND     F_CPU
+#define REFRESH_STATS_CYCLE_COUNT()         ARM_DWT_CYCCNT
+#endif
+
+static INLINE void recordRefreshTiming(refreshTimingAccumulator *timing, uint32_t cycles) {
+    if (!timing->count || cycles < timing->minCycles)
+        timing->minCycles = cycles;
+    if (cycles > timing->maxCycles)
+        timing->maxCycles = cycles;
+    timing->totalCycles += cycles;
+    timing->count++;
+}
+
+// wrap a block of code to record its cycle count in refreshStats.name
+#define REFRESH_STATS_START(name)   uint32_t name##StartCycles = REFRESH_STATS_CYCLE_COUNT()
+#define REFRESH_STATS_END(name)     recordRefreshTiming(&refreshStats.name, REFRESH_STATS_CYCLE_COUNT() - name##StartCycles)
+#else
+#define REFRESH_STATS_START(name)
+#define REFRESH_STATS_END(name)
+#endif
 
 
 SmartMatrix* SmartMatrix::m_Singleton = NULL;
@@ -113,33 +234,108 @@ SmartMatrix::SmartMatrix(void)
 #endif
 {
     m_Singleton = this;
+
+#if BACKGROUND_INDEXED_COLOR
+    // default palette splits the index into 3 bits red, 3 bits green and 2 bits blue
+    for (int i = 0; i < 256; i++) {
+        backgroundPalette[0][i] = rgb24(((i >> 5) * 255) / 7, (((i >> 2) & 0x07) * 255) / 7, ((i & 0x03) * 255) / 3);
+        backgroundPalette[1][i] = backgroundPalette[0][i];
+    }
+#endif
 }
 
-INLINE void SmartMatrix::matrixCalculations(void) {
-    static unsigned char currentRow = 0;
+// once-per-frame updates, returns true if anything changed that affects the rows sent to the display
+INLINE bool SmartMatrix::handleFrameUpdates(void) {
 	static SmartMatrix &matrix = SmartMatrix::getSingleton();
+    bool frameChanged = foregroundCopyPending || colorSpreadSwapPending || brightnessChange;
+#if BACKGROUND_INDEXED_COLOR
+    frameChanged = frameChanged || paletteSwapPending;
+#endif
 
-    // only run the loop if there is free space, and fill the entire buffer before returning
-    while (!cbIsFull(&dmaBuffer)) {
-        // do once-per-frame updates
-        if (!currentRow) {
-            handleBufferSwap();
-            matrix.handleForegroundDrawingCopy();
+    REFRESH_STATS_START(frameUpdate);
 
-            calculateBackgroundLUT();
+    REFRESH_STATS_START(bufferSwap);
+    if (handleBufferSwap(refreshFrameCount))
+        frameChanged = true;
+    REFRESH_STATS_END(bufferSwap);
+
+    REFRESH_STATS_START(foregroundUpdate);
+    matrix.handleForegroundDrawingCopy();
+
+    // switch to color tables rebuilt after a color correction or background brightness change
+    if (colorSpreadSwapPending) {
+        colorSpreadRefreshSet = !colorSpreadRefreshSet;
+        colorSpreadSwapPending = false;
+    }
+
+#if BACKGROUND_INDEXED_COLOR
+    if (paletteSwapPending) {
+        paletteRefreshSet = !paletteRefreshSet;
+        paletteSwapPending = false;
+    }
+#endif
 
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_3, HIGH); // oscilloscope trigger
 #endif
-            matrix.updateForeground();
+    if (matrix.updateForeground())
+        frameChanged = true;
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_3, LOW);
 #endif
+    REFRESH_STATS_END(foregroundUpdate);
 
-            if (brightnessChange) {
-                calculateTimerLut();
-                brightnessChange = false;
-            }
+    // layers applied by the refresh, only timed as part of frameUpdate
+    if (handleBackgroundScrollUpdate())
+        frameChanged = true;
+
+    if (handleTileLayerUpdate())
+        frameChanged = true;
+
+    if (handleSpriteUpdate())
+        frameChanged = true;
+
+    if (brightnessChange) {
+        calculateTimerLut();
+        brightnessChange = false;
+    }
+
+    REFRESH_STATS_END(frameUpdate);
+
+    return frameChanged;
+}
+
+#if STATIC_FRAME_REFRESH
+INLINE void SmartMatrix::matrixCalculations(void) {
+    int i;
+
+    // called once per frame: the refresh ISR just steps through the rows of a packed frame,
+    // a new frame is packed into the other half of the buffer only when something changed
+    refreshFrameCount++;
+    if (!handleFrameUpdates())
+        return;
+
+    // keep the refresh ISR from switching to a frame that is being packed
+    staticFramePending = false;
+
+    for (i = 0; i < MATRIX_ROWS_PER_FRAME; i++) {
+        REFRESH_STATS_START(loadMatrixBuffers);
+        SmartMatrix::loadMatrixBuffers(i, STATIC_FRAME_ROW_BUFFER(!staticFrameRefresh, i));
+        REFRESH_STATS_END(loadMatrixBuffers);
+    }
+
+    staticFramePending = true;
+}
+#else
+INLINE void SmartMatrix::matrixCalculations(void) {
+    static unsigned char currentRow = 0;
+
+    // only run the loop if there is free space, and fill the entire buffer before returning
+    while (!dmaBuffer.isFull()) {
+        // do once-per-frame updates
+        if (!currentRow) {
+            refreshFrameCount++;
+            handleFrameUpdates();
         }
 
         // do once-per-line updates
@@ -149,10 +345,17 @@ INLINE void SmartMatrix::matrixCalculations(void) {
         if (++currentRow >= MATRIX_ROWS_PER_FRAME)
             currentRow = 0;
 
-        SmartMatrix::loadMatrixBuffers(currentRow);
-        cbWrite(&dmaBuffer);
+        unsigned char freeRowBuffer = dmaBuffer.nextWrite();
+        dmaBufferFrame[freeRowBuffer] = refreshFrameCount;
+        dmaBufferRow[freeRowBuffer] = currentRow;
+
+        REFRESH_STATS_START(loadMatrixBuffers);
+        SmartMatrix::loadMatrixBuffers(currentRow, freeRowBuffer);
+        REFRESH_STATS_END(loadMatrixBuffers);
+        dmaBuffer.write();
     }
 }
+#endif
 
 INLINE void SmartMatrix::calculateTimerLut(void) {
     int i;
@@ -179,10 +382,154 @@ INLINE void SmartMatrix::calculateTimerLut(void) {
     }
 }
 
+// called from outside the ISR, waits until the refresh has switched to the previously rebuilt tables
+void SmartMatrix::calculateColorSpreadLUT(void) {
+    int i, j;
+
+    while (refreshStarted && colorSpreadSwapPending);
+
+    REFRESH_STATS_START(colorTables);
+    calculateBackgroundLUT();
+
+    uint32_t (*foregroundLUT)[GPIO_WORDS_PER_CLOCK] = colorSpreadLUT[!colorSpreadRefreshSet][COLOR_SPREAD_FOREGROUND];
+    uint32_t (*backgroundLUT)[GPIO_WORDS_PER_CLOCK] = colorSpreadLUT[!colorSpreadRefreshSet][COLOR_SPREAD_BACKGROUND];
+
+    for (i = 0; i < 256; i++) {
+        // colorCorrection() returns the uncorrected value in the top bits of color_chan_t for ccNone
+        uint16_t foreground = colorCorrection(i);
+        uint16_t background = (_ccmode != ccNone) ? backgroundColorCorrection(i) : colorCorrection(i);
+
+#if LATCHES_PER_ROW == 12
+        foreground >>= 4;
+        background >>= 4;
+#endif
+
+        for (j = 0; j < GPIO_WORDS_PER_CLOCK; j++) {
+            foregroundLUT[i][j] = SPREAD_NIBBLE(foreground, j, 0);
+            backgroundLUT[i][j] = SPREAD_NIBBLE(background, j, 0);
+        }
+    }
+
+    REFRESH_STATS_END(colorTables);
+    colorSpreadSwapPending = true;
+}
+
+// writes the palette set not used by refresh, starting from the latest palette, and has refresh switch to it
+void SmartMatrix::setPalette(const rgb24 colors[], uint8_t first, uint16_t count) {
+#if BACKGROUND_INDEXED_COLOR
+    while (refreshStarted && paletteSwapPending);
+
+    unsigned char updateSet = !paletteRefreshSet;
+    if (updateSet != backgroundPaletteSet)
+        memcpy((uint8_t *)backgroundPalette[updateSet], (const uint8_t *)backgroundPalette[backgroundPaletteSet], sizeof(backgroundPalette[0]));
+
+    if (count > 256 - first)
+        count = 256 - first;
+    for (int i = 0; i < count; i++)
+        backgroundPalette[updateSet][first + i] = colors[i];
+
+    backgroundPaletteSet = updateSet;
+    paletteSwapPending = true;
+#else
+    (void)colors;
+    (void)first;
+    (void)count;
+#endif
+}
+
+void SmartMatrix::setPaletteColor(uint8_t index, const rgb24& color) {
+    setPalette(&color, index, 1);
+}
+
+const rgb24 SmartMatrix::getPaletteColor(uint8_t index) const {
+#if BACKGROUND_INDEXED_COLOR
+    return backgroundPalette[backgroundPaletteSet][index];
+#else
+    (void)index;
+    return rgb24(0, 0, 0);
+#endif
+}
+
+#if BACKGROUND_INDEXED_COLOR
+const rgb24 *SmartMatrix::getRefreshPalette(void) {
+    return backgroundPalette[paletteRefreshSet];
+}
+#endif
+
+#if REFRESH_STATS_ENABLED
+static void copyRefreshTiming(refresh_timing *timing, const refreshTimingAccumulator *accumulator) {
+    timing->count = accumulator->count;
+    timing->minCycles = accumulator->minCycles;
+    timing->maxCycles = accumulator->maxCycles;
+    timing->avgCycles = accumulator->count ? (uint32_t)(accumulator->totalCycles / accumulator->count) : 0;
+}
+#endif
+
+void SmartMatrix::getRefreshStats(refresh_stats *stats) {
+    memset(stats, 0x00, sizeof(refresh_stats));
+
+#if REFRESH_STATS_ENABLED
+    stats->cyclesPerSecond = REFRESH_STATS_CYCLES_PER_SECOND;
+    stats->rowPeriodCycles = REFRESH_STATS_CYCLES_PER_SECOND / MATRIX_REFRESH_RATE / MATRIX_ROWS_PER_FRAME;
+
+    // keep the ISRs from updating the statistics while they're copied
+    noInterrupts();
+    copyRefreshTiming(&stats->rowShiftCompleteISR, &refreshStats.rowShiftCompleteISR);
+    copyRefreshTiming(&stats->rowCalculationISR, &refreshStats.rowCalculationISR);
+    copyRefreshTiming(&stats->loadMatrixBuffers, &refreshStats.loadMatrixBuffers);
+    copyRefreshTiming(&stats->frameUpdate, &refreshStats.frameUpdate);
+    copyRefreshTiming(&stats->bufferSwap, &refreshStats.bufferSwap);
+    copyRefreshTiming(&stats->foregroundUpdate, &refreshStats.foregroundUpdate);
+    copyRefreshTiming(&stats->colorTables, &refreshStats.colorTables);
+    interrupts();
+#endif
+}
+
+void SmartMatrix::getRefreshUnderruns(refresh_underruns *underruns) {
+    noInterrupts();
+    memcpy(underruns, (const void *)&refreshUnderruns, sizeof(refresh_underruns));
+    interrupts();
+}
+
+void SmartMatrix::resetRefreshUnderruns(void) {
+    noInterrupts();
+    memset((void *)&refreshUnderruns, 0x00, sizeof(refresh_underruns));
+    reportedUnderrunCount = 0;
+    reportedLateRowCount = 0;
+    interrupts();
+}
+
+void SmartMatrix::setRefreshEventCallback(refresh_cb func) {
+    refreshEventCallback = func;
+}
+
+uint32_t SmartMatrix::getRefreshFrameCount(void) const {
+    return refreshFrameCount;
+}
+
+void SmartMatrix::setVsyncCallback(vsync_cb func) {
+    reportedFrameCount = refreshFrameCount;
+    vsyncCallback = func;
+}
+
+void SmartMatrix::resetRefreshStats(void) {
+#if REFRESH_STATS_ENABLED
+    noInterrupts();
+    memset(&refreshStats, 0x00, sizeof(refreshStats));
+    interrupts();
+#endif
+}
+
 void SmartMatrix::begin(void)
 {
     int i;
-    cbInit(&dmaBuffer, DMA_BUFFER_NUMBER_OF_ROWS);
+    dmaBuffer.reset();
+
+#if REFRESH_STATS_ENABLED && !defined(SMARTMATRIX_HOST)
+    // start the DWT cycle counter
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
 
     // fill addressLUT
     for (i = 0; i < MATRIX_ROWS_PER_FRAME; i++) {
@@ -207,11 +554,19 @@ void SmartMatrix::begin(void)
     // fill timerLUT
     calculateTimerLut();
 
+    // load color correction tables
+    calculateColorSpreadLUT();
+    colorSpreadRefreshSet = !colorSpreadRefreshSet;
+    colorSpreadSwapPending = false;
+
     // fill buffer with data before enabling DMA
+#if STATIC_FRAME_REFRESH
+    handleFrameUpdates();
+    for (i = 0; i < MATRIX_ROWS_PER_FRAME; i++)
+        loadMatrixBuffers(i, STATIC_FRAME_ROW_BUFFER(staticFrameRefresh, i));
+#else
     matrixCalculations();
-
-    // load color correction table
-    calculateBackgroundLUT();
+#endif
 
     // setup debug output
 #ifdef DEBUG_PINS_ENABLED
@@ -243,6 +598,7 @@ void SmartMatrix::begin(void)
     pinMode(ADDX_TEENSY_PIN_3, OUTPUT);
 #endif
 
+#ifndef SMARTMATRIX_HOST
     // setup FTM1
     FTM1_SC = 0;
     FTM1_CNT = 0;
@@ -376,10 +732,20 @@ void SmartMatrix::begin(void)
 
     // at the end after everything is set up: enable timer from system clock, with appropriate prescale
     FTM1_SC = FTM_SC_CLKS(1) | FTM_SC_PS(LATCH_TIMER_PRESCALE);
+#endif
+
+    refreshStarted = true;
+
+#ifdef SMARTMATRIX_HOST
+    // host model: DMA starts on the first row in the buffer, the latch timer is run with matrixHostRunRows()
+    dmaUpdateAddress.TCD->SADDR = &matrixUpdateBlocks[0][0].addressValues;
+    dmaUpdateTimer.TCD->SADDR = &matrixUpdateBlocks[0][0].timerValues.timer_oe;
+    dmaClockOutData.TCD->SADDR = matrixUpdateData[0][0];
+#endif
 }
 
 extern bool hasForeground;
-INLINE void SmartMatrix::loadMatrixBuffers(unsigned char currentRow) {
+INLINE void SmartMatrix::loadMatrixBuffers(unsigned char currentRow, unsigned char freeRowBuffer) {
 	static SmartMatrix &matrix = SmartMatrix::getSingleton();
     int i, j;
 
@@ -388,8 +754,6 @@ INLINE void SmartMatrix::loadMatrixBuffers(unsigned char currentRow) {
     rowAddressPair.bits_to_set = addressLUT[currentRow].bits_to_set;
     rowAddressPair.bits_to_clear = addressLUT[currentRow].bits_to_clear;
 
-    unsigned char freeRowBuffer = cbGetNextWrite(&dmaBuffer);
-
     // for each color bit, fill buffer with pixel data for all columns in current rows
     for (j = 0; j < LATCHES_PER_ROW; j++) {
         // copy bits to set and clear to generate address for current block
@@ -400,310 +764,179 @@ INLINE void SmartMatrix::loadMatrixBuffers(unsigned char currentRow) {
         matrixUpdateBlocks[freeRowBuffer][j].timerValues.timer_oe = timerLUT[j].timer_oe;
     }
 
-    rgb24 tempPixel;
+    const int gpioBitR1 = GPIO_BIT_POSITION(p0r1);
+    const int gpioBitG1 = GPIO_BIT_POSITION(p0g1);
+    const int gpioBitB1 = GPIO_BIT_POSITION(p0b1);
+    const int gpioBitR2 = GPIO_BIT_POSITION(p0r2);
+    const int gpioBitG2 = GPIO_BIT_POSITION(p0g2);
+    const int gpioBitB2 = GPIO_BIT_POSITION(p0b2);
+    const uint32_t gpioClockMask = 0x01010101 << GPIO_BIT_POSITION(p0clk);
 
     bool bHasForeground = hasForeground;
-    bool bHasCC = SmartMatrix::_ccmode != ccNone;
-    rgb24 *pRow = SmartMatrix::getRefreshRow(currentRow);
-    rgb24 *pRow2 = SmartMatrix::getRefreshRow(currentRow + MATRIX_ROW_PAIR_OFFSET);
+    // rows that are scrolled or have layers drawn over them are composed into these and packed in their place
+    static bgcolor_t composedRows[2][MATRIX_WIDTH];
+    int backgroundStride;
+    const bgcolor_t *pRow = SmartMatrix::getScrolledRefreshRow(currentRow, composedRows[0], &backgroundStride);
+    const bgcolor_t *pRow2 = SmartMatrix::getScrolledRefreshRow(currentRow + MATRIX_ROW_PAIR_OFFSET, composedRows[1], &backgroundStride);
+#if BACKGROUND_INDEXED_COLOR
+    // palette entries are looked up on the way into the color tables, so changing the palette costs nothing per pixel
+    const rgb24 *palette = getRefreshPalette();
+#endif
+#if !BACKGROUND_LOCAL_COORDINATES
+    // hardware rows are contiguous, keep the stride a constant for the loop below
+    backgroundStride = 1;
+#endif
 
-    for (i = 0; i < MATRIX_WIDTH; i++) {
+    // the tile layer is composed over the background rows, which may already be in the row buffers
+    if (loadTileLayerRow(currentRow, composedRows[0], pRow, backgroundStride)) {
+        loadTileLayerRow(currentRow + MATRIX_ROW_PAIR_OFFSET, composedRows[1], pRow2, backgroundStride);
+        pRow = composedRows[0];
+        pRow2 = composedRows[1];
+        backgroundStride = 1;
+    }
 
-#if LATCHES_PER_ROW >= 12
-        uint16_t temp0red,temp0green,temp0blue,temp1red,temp1green,temp1blue;
-#else
-        uint8_t temp0red,temp0green,temp0blue,temp1red,temp1green,temp1blue;
-#endif
+    // sprites go on top, only rows with sprites on them are composed
+    if (spritesOnRow(currentRow) || spritesOnRow(currentRow + MATRIX_ROW_PAIR_OFFSET)) {
+        loadSpriteRow(currentRow, composedRows[0], pRow, backgroundStride);
+        loadSpriteRow(currentRow + MATRIX_ROW_PAIR_OFFSET, composedRows[1], pRow2, backgroundStride);
+        pRow = composedRows[0];
+        pRow2 = composedRows[1];
+        backgroundStride = 1;
+    }
 
-        if (bHasForeground && matrix.getForegroundPixel(i, currentRow, &tempPixel)) {
-            if(bHasCC) {
-                // load foreground pixel with color correction
-                temp0red = colorCorrection(tempPixel.red);
-                temp0green = colorCorrection(tempPixel.green);
-                temp0blue = colorCorrection(tempPixel.blue);
-            } else {
-                // load foreground pixel without color correction
-                temp0red = tempPixel.red;
-                temp0green = tempPixel.green;
-                temp0blue = tempPixel.blue;
-            }
-        } else {
-            if(bHasCC) {
-                // load background pixel with color correction
-                temp0red = backgroundColorCorrection(pRow[i].red);
-                temp0green = backgroundColorCorrection(pRow[i].green);
-                temp0blue = backgroundColorCorrection(pRow[i].blue);
-            } else {
-                // load background pixel without color correction
-                temp0red = pRow[i].red;
-                temp0green = pRow[i].green;
-                temp0blue = pRow[i].blue;
-            }
+    const uint32_t (*foregroundLUT)[GPIO_WORDS_PER_CLOCK] = colorSpreadLUT[colorSpreadRefreshSet][COLOR_SPREAD_FOREGROUND];
+    const uint32_t (*backgroundLUT)[GPIO_WORDS_PER_CLOCK] = colorSpreadLUT[colorSpreadRefreshSet][COLOR_SPREAD_BACKGROUND];
+
+    // foreground masks and scroller colors for both rows, with the table entries for each scroller's color looked up once
+    const uint32_t *foregroundMask0 = NULL, *foregroundMask1 = NULL;
+    const uint8_t *foregroundColors0 = NULL, *foregroundColors1 = NULL;
+    int foregroundColorStride = 0;
+    const uint32_t *scrollerLUT[MATRIX_SCROLLERS][3];
+
+    if (bHasForeground) {
+        foregroundMask0 = getForegroundMaskRow(currentRow);
+        foregroundMask1 = getForegroundMaskRow(currentRow + MATRIX_ROW_PAIR_OFFSET);
+        foregroundColors0 = getForegroundColorIndexes(currentRow, &foregroundColorStride);
+        foregroundColors1 = getForegroundColorIndexes(currentRow + MATRIX_ROW_PAIR_OFFSET, &foregroundColorStride);
+
+        for (j = 0; j < MATRIX_SCROLLERS; j++) {
+            scrollerLUT[j][0] = foregroundLUT[matrix.scrollers[j].textColor.red];
+            scrollerLUT[j][1] = foregroundLUT[matrix.scrollers[j].textColor.green];
+            scrollerLUT[j][2] = foregroundLUT[matrix.scrollers[j].textColor.blue];
+        }
+    }
+
+    for (int maskWord = 0; maskWord < MATRIX_WIDTH / 32; maskWord++) {
+        uint32_t mask0 = 0, mask1 = 0;
+
+        // test 32 columns at once, rows without foreground in them are packed straight from the background
+        if (bHasForeground) {
+            mask0 = foregroundMask0[maskWord];
+            mask1 = foregroundMask1[maskWord];
         }
 
-        if (bHasForeground && matrix.getForegroundPixel(i, currentRow + MATRIX_ROW_PAIR_OFFSET, &tempPixel)) {
-            if(bHasCC) {
-                // load foreground pixel with color correction
-                temp1red = colorCorrection(tempPixel.red);
-                temp1green = colorCorrection(tempPixel.green);
-                temp1blue = colorCorrection(tempPixel.blue);
+        for (i = maskWord * 32; i < (maskWord + 1) * 32; i++) {
+            const uint32_t *temp0red, *temp0green, *temp0blue, *temp1red, *temp1green, *temp1blue;
+
+            // look up the bitplanes for each channel, color correction is included in the tables
+            if (mask0 & 0x80000000) {
+                const uint32_t * const *lut = scrollerLUT[foregroundColors0[i * foregroundColorStride] < MATRIX_SCROLLERS ?
+                    foregroundColors0[i * foregroundColorStride] : 0];
+                temp0red = lut[0];
+                temp0green = lut[1];
+                temp0blue = lut[2];
             } else {
-                // load foreground pixel without color correction
-                temp1red = tempPixel.red;
-                temp1green = tempPixel.green;
-                temp1blue = tempPixel.blue;
+#if BACKGROUND_RGB565
+                // one halfword load, the channels index the same tables after widening to 8 bits
+                const rgb16 pixel = pRow[i * backgroundStride];
+                temp0red = backgroundLUT[pixel.red()];
+                temp0green = backgroundLUT[pixel.green()];
+                temp0blue = backgroundLUT[pixel.blue()];
+#else
+#if BACKGROUND_INDEXED_COLOR
+                const rgb24 *pixel = &palette[pRow[i * backgroundStride]];
+#else
+                const rgb24 *pixel = &pRow[i * backgroundStride];
+#endif
+                temp0red = backgroundLUT[pixel->red];
+                temp0green = backgroundLUT[pixel->green];
+                temp0blue = backgroundLUT[pixel->blue];
+#endif
             }
-        } else {
-            if(bHasCC) {
-                // load background pixel with color correction
-                temp1red = backgroundColorCorrection(pRow2[i].red);
-                temp1green = backgroundColorCorrection(pRow2[i].green);
-                temp1blue = backgroundColorCorrection(pRow2[i].blue);
+
+            if (mask1 & 0x80000000) {
+                const uint32_t * const *lut = scrollerLUT[foregroundColors1[i * foregroundColorStride] < MATRIX_SCROLLERS ?
+                    foregroundColors1[i * foregroundColorStride] : 0];
+                temp1red = lut[0];
+                temp1green = lut[1];
+                temp1blue = lut[2];
             } else {
-                // load background pixel without color correction
-                temp1red = pRow2[i].red;
-                temp1green = pRow2[i].green;
-                temp1blue = pRow2[i].blue;
+#if BACKGROUND_RGB565
+                // one halfword load, the channels index the same tables after widening to 8 bits
+                const rgb16 pixel = pRow2[i * backgroundStride];
+                temp1red = backgroundLUT[pixel.red()];
+                temp1green = backgroundLUT[pixel.green()];
+                temp1blue = backgroundLUT[pixel.blue()];
+#else
+#if BACKGROUND_INDEXED_COLOR
+                const rgb24 *pixel = &palette[pRow2[i * backgroundStride]];
+#else
+                const rgb24 *pixel = &pRow2[i * backgroundStride];
+#endif
+                temp1red = backgroundLUT[pixel->red];
+                temp1green = backgroundLUT[pixel->green];
+                temp1blue = backgroundLUT[pixel->blue];
+#endif
             }
-        }
 
-#if LATCHES_PER_ROW >= 12
-        if(!bHasCC) {
-            temp0red = temp0red << 8;
-            temp0green = temp0green << 8;
-            temp0blue = temp0blue << 8;
-            temp1red = temp1red << 8;
-            temp1green = temp1green << 8;
-            temp1blue = temp1blue << 8;
+            mask0 <<= 1;
+            mask1 <<= 1;
+
+            // each GPIO word holds four bitplanes for the pixel pair, one per byte from LSB to MSB brightness
+            // the tables hold each channel already spread across the bytes, so it only needs to be moved into position
+            for (j = 0; j < GPIO_WORDS_PER_CLOCK; j++) {
+                uint32_t word = (temp0red[j] << gpioBitR1) |
+                                (temp0green[j] << gpioBitG1) |
+                                (temp0blue[j] << gpioBitB1) |
+                                (temp1red[j] << gpioBitR2) |
+                                (temp1green[j] << gpioBitG2) |
+                                (temp1blue[j] << gpioBitB2);
+
+                // copy word to DMA buffer, and the same word with the clock set high into the second half
+                matrixUpdateData[freeRowBuffer][i][j] = word;
+                matrixUpdateData[freeRowBuffer][i][GPIO_WORDS_PER_CLOCK + j] = word | gpioClockMask;
+            }
         }
-#endif
-
-#if LATCHES_PER_ROW == 12
-            temp0red >>= 4;
-            temp0green >>= 4;
-            temp0blue >>= 4;
-
-            temp1red >>= 4;
-            temp1green >>= 4;
-            temp1blue >>= 4;
-#endif
-        // this technique is from Fadecandy
-        union {
-            uint32_t word;
-            struct {
-                // order of bits in word matches how GPIO connects to the display
-                uint32_t GPIO_WORD_ORDER;
-            };
-        } o0, o1, clkset;
-
-
-        o0.word = 0;
-        // set bits starting from LSB brightness moving to MSB brightness with each byte across the word
-        // each word contains four brightness levels for single set of pixels above
-        // o0.p0clk = 0;
-        // o0.p0pad = 0;
-        o0.p0b1 = temp0blue    >> 0;
-        o0.p0r1 = temp0red     >> 0;
-        o0.p0r2 = temp1red     >> 0;
-        o0.p0g1 = temp0green   >> 0;
-        o0.p0g2 = temp1green   >> 0;
-        o0.p0b2 = temp1blue    >> 0;
-
-        // o0.p1clk = 0;
-        // o0.p1pad = 0;
-        o0.p1b1 = temp0blue    >> 1;
-        o0.p1r1 = temp0red     >> 1;
-        o0.p1r2 = temp1red     >> 1;
-        o0.p1g1 = temp0green   >> 1;
-        o0.p1g2 = temp1green   >> 1;
-        o0.p1b2 = temp1blue    >> 1;
-
-        // o0.p2clk = 0;
-        // o0.p2pad = 0;
-        o0.p2b1 = temp0blue    >> 2;
-        o0.p2r1 = temp0red     >> 2;
-        o0.p2r2 = temp1red     >> 2;
-        o0.p2g1 = temp0green   >> 2;
-        o0.p2g2 = temp1green   >> 2;
-        o0.p2b2 = temp1blue    >> 2;
-
-        // o0.p3clk = 0;
-        // o0.p3pad = 0;
-        o0.p3b1 = temp0blue    >> 3;
-        o0.p3r1 = temp0red     >> 3;
-        o0.p3r2 = temp1red     >> 3;
-        o0.p3g1 = temp0green   >> 3;
-        o0.p3g2 = temp1green   >> 3;
-        o0.p3b2 = temp1blue    >> 3;
-
-
-        // continue moving from LSB to MSB brightness with the next word
-        o1.word = 0;
-        // o1.p0clk = 0;
-        // o1.p0pad = 0;
-        o1.p0b1 = temp0blue    >> (0 + 1 * sizeof(uint32_t));
-        o1.p0r1 = temp0red     >> (0 + 1 * sizeof(uint32_t));
-        o1.p0r2 = temp1red     >> (0 + 1 * sizeof(uint32_t));
-        o1.p0g1 = temp0green   >> (0 + 1 * sizeof(uint32_t));
-        o1.p0g2 = temp1green   >> (0 + 1 * sizeof(uint32_t));
-        o1.p0b2 = temp1blue    >> (0 + 1 * sizeof(uint32_t));
-
-        // o1.p1clk = 0;
-        // o1.p1pad = 0;
-        o1.p1b1 = temp0blue    >> (1 + 1 * sizeof(uint32_t));
-        o1.p1r1 = temp0red     >> (1 + 1 * sizeof(uint32_t));
-        o1.p1r2 = temp1red     >> (1 + 1 * sizeof(uint32_t));
-        o1.p1g1 = temp0green   >> (1 + 1 * sizeof(uint32_t));
-        o1.p1g2 = temp1green   >> (1 + 1 * sizeof(uint32_t));
-        o1.p1b2 = temp1blue    >> (1 + 1 * sizeof(uint32_t));
-
-        // o1.p2clk = 0;
-        // o1.p2pad = 0;
-        o1.p2b1 = temp0blue    >> (2 + 1 * sizeof(uint32_t));
-        o1.p2r1 = temp0red     >> (2 + 1 * sizeof(uint32_t));
-        o1.p2r2 = temp1red     >> (2 + 1 * sizeof(uint32_t));
-        o1.p2g1 = temp0green   >> (2 + 1 * sizeof(uint32_t));
-        o1.p2g2 = temp1green   >> (2 + 1 * sizeof(uint32_t));
-        o1.p2b2 = temp1blue    >> (2 + 1 * sizeof(uint32_t));
-
-        // o1.p3clk = 0;
-        // o1.p3pad = 0;
-        o1.p3b1 = temp0blue    >> (3 + 1 * sizeof(uint32_t));
-        o1.p3r1 = temp0red     >> (3 + 1 * sizeof(uint32_t));
-        o1.p3r2 = temp1red     >> (3 + 1 * sizeof(uint32_t));
-        o1.p3g1 = temp0green   >> (3 + 1 * sizeof(uint32_t));
-        o1.p3g2 = temp1green   >> (3 + 1 * sizeof(uint32_t));
-        o1.p3b2 = temp1blue    >> (3 + 1 * sizeof(uint32_t));
-
-#if LATCHES_PER_ROW >= 12
-        union {
-            uint32_t word;
-            struct {
-                // order of bits in word matches how GPIO connects to the display
-                uint32_t GPIO_WORD_ORDER;
-            };
-        } o2;
-
-        o2.word = 0;
-        //o2.p0clk = 0;
-        //o2.p0pad = 0;
-        o2.p0b1 = temp0blue    >> (0 + 2 * sizeof(uint32_t));
-        o2.p0r1 = temp0red     >> (0 + 2 * sizeof(uint32_t));
-        o2.p0r2 = temp1red     >> (0 + 2 * sizeof(uint32_t));
-        o2.p0g1 = temp0green   >> (0 + 2 * sizeof(uint32_t));
-        o2.p0g2 = temp1green   >> (0 + 2 * sizeof(uint32_t));
-        o2.p0b2 = temp1blue    >> (0 + 2 * sizeof(uint32_t));
-
-        //o2.p1clk = 0;
-        //o2.p1pad = 0;
-        o2.p1b1 = temp0blue    >> (1 + 2 * sizeof(uint32_t));
-        o2.p1r1 = temp0red     >> (1 + 2 * sizeof(uint32_t));
-        o2.p1r2 = temp1red     >> (1 + 2 * sizeof(uint32_t));
-        o2.p1g1 = temp0green   >> (1 + 2 * sizeof(uint32_t));
-        o2.p1g2 = temp1green   >> (1 + 2 * sizeof(uint32_t));
-        o2.p1b2 = temp1blue    >> (1 + 2 * sizeof(uint32_t));
-
-        //o2.p2clk = 0;
-        //o2.p2pad = 0;
-        o2.p2b1 = temp0blue    >> (2 + 2 * sizeof(uint32_t));
-        o2.p2r1 = temp0red     >> (2 + 2 * sizeof(uint32_t));
-        o2.p2r2 = temp1red     >> (2 + 2 * sizeof(uint32_t));
-        o2.p2g1 = temp0green   >> (2 + 2 * sizeof(uint32_t));
-        o2.p2g2 = temp1green   >> (2 + 2 * sizeof(uint32_t));
-        o2.p2b2 = temp1blue    >> (2 + 2 * sizeof(uint32_t));
-
-
-        //o2.p3clk = 0;
-        //o2.p3pad = 0;
-        o2.p3b1 = temp0blue    >> (3 + 2 * sizeof(uint32_t));
-        o2.p3r1 = temp0red     >> (3 + 2 * sizeof(uint32_t));
-        o2.p3r2 = temp1red     >> (3 + 2 * sizeof(uint32_t));
-        o2.p3g1 = temp0green   >> (3 + 2 * sizeof(uint32_t));
-        o2.p3g2 = temp1green   >> (3 + 2 * sizeof(uint32_t));
-        o2.p3b2 = temp1blue    >> (3 + 2 * sizeof(uint32_t));
-#endif
-
-#if LATCHES_PER_ROW == 16
-        union {
-            uint32_t word;
-            struct {
-                // order of bits in word matches how GPIO connects to the display
-                uint32_t GPIO_WORD_ORDER;
-            };
-        } o3;
-
-        o3.word = 0;
-        //o3.p0clk = 0;
-        //o3.p0pad = 0;
-        o3.p0b1 = temp0blue    >> (0 + 3 * sizeof(uint32_t));
-        o3.p0r1 = temp0red     >> (0 + 3 * sizeof(uint32_t));
-        o3.p0r2 = temp1red     >> (0 + 3 * sizeof(uint32_t));
-        o3.p0g1 = temp0green   >> (0 + 3 * sizeof(uint32_t));
-        o3.p0g2 = temp1green   >> (0 + 3 * sizeof(uint32_t));
-        o3.p0b2 = temp1blue    >> (0 + 3 * sizeof(uint32_t));
-
-        //o3.p1clk = 0;
-        //o3.p1pad = 0;
-        o3.p1b1 = temp0blue    >> (1 + 3 * sizeof(uint32_t));
-        o3.p1r1 = temp0red     >> (1 + 3 * sizeof(uint32_t));
-        o3.p1r2 = temp1red     >> (1 + 3 * sizeof(uint32_t));
-        o3.p1g1 = temp0green   >> (1 + 3 * sizeof(uint32_t));
-        o3.p1g2 = temp1green   >> (1 + 3 * sizeof(uint32_t));
-        o3.p1b2 = temp1blue    >> (1 + 3 * sizeof(uint32_t));
-
-        //o3.p2clk = 0;
-        //o3.p2pad = 0;
-        o3.p2b1 = temp0blue    >> (2 + 3 * sizeof(uint32_t));
-        o3.p2r1 = temp0red     >> (2 + 3 * sizeof(uint32_t));
-        o3.p2r2 = temp1red     >> (2 + 3 * sizeof(uint32_t));
-        o3.p2g1 = temp0green   >> (2 + 3 * sizeof(uint32_t));
-        o3.p2g2 = temp1green   >> (2 + 3 * sizeof(uint32_t));
-        o3.p2b2 = temp1blue    >> (2 + 3 * sizeof(uint32_t));
-
-
-        //o3.p3clk = 0;
-        //o3.p3pad = 0;
-        o3.p3b1 = temp0blue    >> (3 + 3 * sizeof(uint32_t));
-        o3.p3r1 = temp0red     >> (3 + 3 * sizeof(uint32_t));
-        o3.p3r2 = temp1red     >> (3 + 3 * sizeof(uint32_t));
-        o3.p3g1 = temp0green   >> (3 + 3 * sizeof(uint32_t));
-        o3.p3g2 = temp1green   >> (3 + 3 * sizeof(uint32_t));
-        o3.p3b2 = temp1blue    >> (3 + 3 * sizeof(uint32_t));
-#endif
-
-        clkset.word = 0x00;
-        clkset.p0clk = 1;
-        clkset.p1clk = 1;
-        clkset.p2clk = 1;
-        clkset.p3clk = 1;
-
-        // copy words to DMA buffer
-        matrixUpdateData[freeRowBuffer][i][0] = o0.word;
-        matrixUpdateData[freeRowBuffer][i][1] = o1.word;
-
-        // copy the next set of words with the same data, but clock set high
-        matrixUpdateData[freeRowBuffer][i][LATCHES_PER_ROW / sizeof(uint32_t) + 0] = o0.word | clkset.word;
-        matrixUpdateData[freeRowBuffer][i][LATCHES_PER_ROW / sizeof(uint32_t) + 1] = o1.word | clkset.word;
-
-#if LATCHES_PER_ROW >= 12
-        matrixUpdateData[freeRowBuffer][i][2] = o2.word;
-        matrixUpdateData[freeRowBuffer][i][LATCHES_PER_ROW / sizeof(uint32_t) + 2] = o2.word | clkset.word;
-#endif
-#if LATCHES_PER_ROW == 16
-        matrixUpdateData[freeRowBuffer][i][3] = o3.word;
-        matrixUpdateData[freeRowBuffer][i][LATCHES_PER_ROW / sizeof(uint32_t) + 3] = o3.word | clkset.word;
-#endif
     }
-
 }
 
 void rowCalculationISR(void) {
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_2, HIGH); // oscilloscope trigger
 #endif
+    REFRESH_STATS_START(rowCalculationISR);
 
     SmartMatrix::matrixCalculations();
 
+    REFRESH_STATS_END(rowCalculationISR);
+
+    // report new underruns outside of the higher priority DMA complete ISR
+    if (refreshEventCallback) {
+        if (reportedUnderrunCount != refreshUnderruns.underrunCount) {
+            reportedUnderrunCount = refreshUnderruns.underrunCount;
+            refreshEventCallback(eRefreshEvent::Underrun, refreshUnderruns.underrunFrame, refreshUnderruns.underrunRow);
+        }
+        if (reportedLateRowCount != refreshUnderruns.lateRowCount) {
+            reportedLateRowCount = refreshUnderruns.lateRowCount;
+            refreshEventCallback(eRefreshEvent::LateRow, refreshUnderruns.lateRowFrame, refreshUnderruns.lateRowRow);
+        }
+    }
+
+    // report the start of each new frame, once even if more than one started
+    if (vsyncCallback && reportedFrameCount != refreshFrameCount) {
+        reportedFrameCount = refreshFrameCount;
+        vsyncCallback(reportedFrameCount);
+    }
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_2, LOW);
 #endif
@@ -715,11 +948,46 @@ void rowShiftCompleteISR(void) {
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_1, HIGH); // oscilloscope trigger
 #endif
-    // done with previous row, mark it as read
-    cbRead(&dmaBuffer);
+    REFRESH_STATS_START(rowShiftCompleteISR);
+
+#if STATIC_FRAME_REFRESH
+    // move to the next row of the packed frame, switching to a newly packed frame at the top
+    if (++staticFrameRow >= MATRIX_ROWS_PER_FRAME) {
+        staticFrameRow = 0;
+
+        if (staticFramePending) {
+            staticFrameRefresh = !staticFrameRefresh;
+            staticFramePending = false;
+        }
+    }
+
+    int currentRow = STATIC_FRAME_ROW_BUFFER(staticFrameRefresh, staticFrameRow);
+#else
+    if (dmaBuffer.count() > 1) {
+        // done with previous row, mark it as read
+        dmaBuffer.read();
+
+#if DMA_BUFFER_NUMBER_OF_ROWS > 2
+        // the row calculation ISR is behind, only the row about to be refreshed is buffered
+        if (dmaBuffer.count() == 1) {
+            int lateRow = dmaBuffer.nextRead();
+            refreshUnderruns.lateRowCount++;
+            refreshUnderruns.lateRowFrame = dmaBufferFrame[lateRow];
+            refreshUnderruns.lateRowRow = dmaBufferRow[lateRow];
+        }
+#endif
+    } else {
+        // underrun: the next row isn't ready, the next slot is stale or still being written
+        // refresh the previous row again instead, it's still complete
+        int repeatedRow = dmaBuffer.nextRead();
+        refreshUnderruns.underrunCount++;
+        refreshUnderruns.underrunFrame = dmaBufferFrame[repeatedRow];
+        refreshUnderruns.underrunRow = dmaBufferRow[repeatedRow];
+    }
 
     // get next row to draw to display and update DMA pointers
-    int currentRow = cbGetNextRead(&dmaBuffer);
+    int currentRow = dmaBuffer.nextRead();
+#endif
     dmaUpdateAddress.TCD->SADDR = &matrixUpdateBlocks[currentRow][0].addressValues;
     dmaUpdateTimer.TCD->SADDR = &matrixUpdateBlocks[currentRow][0].timerValues.timer_oe;
     dmaClockOutData.TCD->SADDR = matrixUpdateData[currentRow][0];
@@ -728,12 +996,154 @@ void rowShiftCompleteISR(void) {
     CORE_PIN3_CONFIG |= (1 << 24);
 
     // trigger software interrupt (DMA channel interrupt used instead of actual softint)
+#if STATIC_FRAME_REFRESH
+    // only needed once per frame
+    if (!staticFrameRow)
+        NVIC_SET_PENDING(IRQ_DMA_CH0 + dmaUpdateAddress.channel);
+#else
     NVIC_SET_PENDING(IRQ_DMA_CH0 + dmaUpdateAddress.channel);
+#endif
 
     // clear pending int
     dmaClockOutData.clearInterrupt();
 
+    REFRESH_STATS_END(rowShiftCompleteISR);
 #ifdef DEBUG_PINS_ENABLED
     digitalWriteFast(DEBUG_PIN_1, LOW); // oscilloscope trigger
 #endif
 }
+
+#ifdef SMARTMATRIX_HOST
+/*
+  software model of the refresh hardware, replaces FTM1, the four linked DMA channels and the GPIO ports
+    each row refreshed by the latch timer reads the current row from the DMA source addresses in the same order
+    the channels do, and records what would have been driven onto the address pins and GPIOD for each latch
+    when the row is done, rowShiftCompleteISR is called, followed by rowCalculationISR if it was pended
+ */
+typedef struct hostRowCapture {
+    uint16_t address;
+    timerpair timerValues[LATCHES_PER_ROW];
+    uint8_t gpioData[LATCHES_PER_ROW][MATRIX_WIDTH * DMA_UPDATES_PER_CLOCK];
+} hostRowCapture;
+
+static hostRowCapture hostCapture[MATRIX_ROWS_PER_FRAME];
+
+volatile uint32_t CORE_PIN3_CONFIG = 0;
+static volatile bool hostRowCalculationPending = false;
+static uint16_t hostAddressPins = 0;
+static uint32_t hostFrameCount = 0;
+static uint64_t hostTicks = 0;
+
+static std::thread hostLatchTimer;
+static std::atomic<bool> hostLatchTimerRunning(false);
+
+void matrixHostSetPending(int) {
+    hostRowCalculationPending = true;
+}
+
+void matrixHostRunRows(uint32_t rows) {
+    while (rows--) {
+        const matrixUpdateBlock *blocks = (const matrixUpdateBlock *)dmaUpdateTimer.TCD->SADDR;
+        const uint8_t *data = (const uint8_t *)dmaClockOutData.TCD->SADDR;
+        int row, i, j, k;
+
+        // dmaOutputAddress - address pins are updated with set+clear writes on every latch
+        for (j = 0; j < LATCHES_PER_ROW; j++) {
+            hostAddressPins &= ~blocks[j].addressValues.bits_to_clear;
+            hostAddressPins |= blocks[j].addressValues.bits_to_set;
+        }
+
+        // find the row that was addressed
+        for (row = 0; row < MATRIX_ROWS_PER_FRAME - 1; row++) {
+            if (addressLUT[row].bits_to_set == (hostAddressPins & ADDX_PIN_MASK))
+                break;
+        }
+
+        hostRowCapture *capture = &hostCapture[row];
+        capture->address = hostAddressPins;
+
+        for (j = 0; j < LATCHES_PER_ROW; j++) {
+            // dmaUpdateTimer - load FTM1_C1V and FTM1_MOD for this latch
+            capture->timerValues[j] = blocks[j].timerValues;
+            hostTicks += blocks[j].timerValues.timer_period;
+
+            // dmaClockOutData - each minor loop sends one byte per clock edge for every column, then moves to the next bit
+            for (i = 0; i < MATRIX_WIDTH; i++) {
+                for (k = 0; k < DMA_UPDATES_PER_CLOCK; k++) {
+                    capture->gpioData[j][i * DMA_UPDATES_PER_CLOCK + k] =
+                        data[(i * sizeof(matrixUpdateData[0][0])) + (k * sizeof(matrixUpdateData[0][0]) / 2) + j];
+                }
+            }
+        }
+
+        if (row == MATRIX_ROWS_PER_FRAME - 1)
+            hostFrameCount++;
+
+        // major loop complete interrupt, the row calculation interrupt has lower priority and runs after
+        rowShiftCompleteISR();
+
+        if (hostRowCalculationPending) {
+            hostRowCalculationPending = false;
+            rowCalculationISR();
+        }
+    }
+}
+
+void matrixHostRunFrames(uint32_t frames) {
+    matrixHostRunRows(frames * MATRIX_ROWS_PER_FRAME);
+}
+
+void matrixHostStartLatchTimer(bool realtime) {
+    if (hostLatchTimerRunning)
+        return;
+
+    hostLatchTimerRunning = true;
+    hostLatchTimer = std::thread([realtime]() {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        uint64_t startTicks = hostTicks;
+
+        while (hostLatchTimerRunning) {
+            matrixHostRunRows(1);
+
+            if (realtime) {
+                std::this_thread::sleep_until(start +
+                    std::chrono::nanoseconds(((hostTicks - startTicks) * 1000000000ULL) / F_BUS));
+            }
+        }
+    });
+}
+
+void matrixHostStopLatchTimer(void) {
+    if (!hostLatchTimerRunning)
+        return;
+
+    hostLatchTimerRunning = false;
+    hostLatchTimer.join();
+}
+
+uint32_t matrixHostGetCycleCount(void) {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t matrixHostGetFrameCount(void) {
+    return hostFrameCount;
+}
+
+uint64_t matrixHostGetTicks(void) {
+    return hostTicks;
+}
+
+uint16_t matrixHostGetCapturedAddress(uint8_t row) {
+    return hostCapture[row].address;
+}
+
+void matrixHostGetCapturedTimer(uint8_t row, uint8_t latch, uint16_t *oe, uint16_t *period) {
+    *oe = hostCapture[row].timerValues[latch].timer_oe;
+    *period = hostCapture[row].timerValues[latch].timer_period;
+}
+
+const uint8_t *matrixHostGetCapturedData(uint8_t row, uint8_t latch) {
+    return hostCapture[row].gpioData[latch];
+}
+#endif
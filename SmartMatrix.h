@@ -24,7 +24,11 @@
 #ifndef SmartMatrix_h
 #define SmartMatrix_h
 
+#ifdef SMARTMATRIX_HOST
+#include "MatrixHost.h"
+#else
 #include "Arduino.h"
+#endif
 #include <stdint.h>
 #include "ringbuffer.h"
 
@@ -95,6 +99,9 @@ typedef struct rgb24
 	{}
 
 
+	// copy, declared because operator= is
+	rgb24(const rgb24 &rv) = default;
+
 	// assign
 	rgb24& operator=(const rgb24 &rv)
 	{
@@ -118,6 +125,31 @@ typedef struct rgb24
 	}
 }  __attribute__ ((aligned(1), packed)) rgb24;
 
+// 16-bit color, 5 bits red, 6 bits green and 5 bits blue from MSB to LSB
+typedef struct rgb16
+{
+	uint16_t rgb;
+
+
+	rgb16(uint8_t red = 0, uint8_t green = 0, uint8_t blue = 0)
+		: rgb(((red & 0xf8) << 8) | ((green & 0xfc) << 3) | (blue >> 3))
+	{}
+
+	rgb16(const rgb24 &color)
+		: rgb(((color.red & 0xf8) << 8) | ((color.green & 0xfc) << 3) | (color.blue >> 3))
+	{}
+
+
+	// channels widened back to 8 bits by repeating their top bits, so full scale is 255
+	uint8_t red() const		{ return ((rgb >> 8) & 0xf8) | (rgb >> 13); }
+	uint8_t green() const	{ return ((rgb >> 3) & 0xfc) | ((rgb >> 9) & 0x03); }
+	uint8_t blue() const	{ return ((rgb << 3) & 0xf8) | ((rgb >> 2) & 0x07); }
+
+	// compare
+	bool operator==(const rgb16 &rv) const	{ return rgb == rv.rgb; }
+	bool operator!=(const rgb16 &rv) const	{ return rgb != rv.rgb; }
+} rgb16;
+
 
 #if COLOR_DEPTH_RGB > 24
 #define color_chan_t uint16_t
@@ -125,6 +157,21 @@ typedef struct rgb24
 #define color_chan_t uint8_t
 #endif
 
+// what a background pixel holds and the background drawing functions take as a color,
+// an index into the palette set with setPalette() when BACKGROUND_INDEXED_COLOR is set,
+// rgb16 when BACKGROUND_RGB565 is set, which rgb24 colors are converted to
+#if BACKGROUND_INDEXED_COLOR && BACKGROUND_RGB565
+#error "only one of BACKGROUND_INDEXED_COLOR and BACKGROUND_RGB565 can be set"
+#endif
+
+#if BACKGROUND_INDEXED_COLOR
+typedef uint8_t bgcolor_t;
+#elif BACKGROUND_RGB565
+typedef rgb16 bgcolor_t;
+#else
+typedef rgb24 bgcolor_t;
+#endif
+
 typedef enum colorCorrectionModes {
     ccNone,
     cc24,
@@ -149,6 +196,57 @@ typedef struct screen_config {
 
 #define SMART_MATRIX_CAN_TRIPLE_BUFFER 1
 
+// with BACKGROUND_BUFFERS = 3, what swapBuffers() does when the refresh hasn't picked up the last frame yet
+typedef enum swapModes {
+    swapLatest,                             // replace it, the refresh always shows the newest frame
+    swapInOrder                             // wait for it, every frame is shown in order
+} swapModes;
+
+// most vertices fillPolygon() accepts, its edge table lives on the stack while it fills
+#define SMART_MATRIX_POLYGON_MAX_POINTS 32
+
+
+// refresh events, reported when the row calculation falls behind the DMA refresh
+enum class eRefreshEvent
+{
+	Underrun,				// Next row wasn't ready in time, the last row was refreshed again.
+	LateRow					// Row was refreshed with no other rows buffered behind it.
+};
+
+typedef void (*refresh_cb)(eRefreshEvent event, uint32_t frame, uint8_t row);
+
+// called at the start of each refresh frame with the frame number from getRefreshFrameCount()
+typedef void (*vsync_cb)(uint32_t frame);
+
+typedef struct refresh_underruns {
+    uint32_t underrunCount;
+    uint32_t underrunFrame;                 // frame and row refreshed again for the last underrun
+    uint8_t underrunRow;
+    uint32_t lateRowCount;
+    uint32_t lateRowFrame;                  // frame and row of the last late row
+    uint8_t lateRowRow;
+} refresh_underruns;
+
+// refresh statistics, cycle counts are from the DWT cycle counter (or the host clock when SMARTMATRIX_HOST is defined)
+typedef struct refresh_timing {
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t avgCycles;
+    uint32_t maxCycles;
+} refresh_timing;
+
+typedef struct refresh_stats {
+    uint32_t cyclesPerSecond;               // to convert cycle counts to time
+    uint32_t rowPeriodCycles;               // time available to refresh one row, the deadline for loading the next
+    refresh_timing rowShiftCompleteISR;     // every entry of the DMA complete interrupt
+    refresh_timing rowCalculationISR;       // every entry of the row calculation interrupt
+    refresh_timing loadMatrixBuffers;       // packing of one row into the DMA buffer
+    refresh_timing frameUpdate;             // all once-per-frame updates
+    refresh_timing bufferSwap;              // handleBufferSwap
+    refresh_timing foregroundUpdate;        // foreground drawing copy, scrolling and redraw
+    refresh_timing colorTables;             // rebuilding the color spread tables (runs outside of the ISR)
+} refresh_stats;
+
 
 // text scroller class
 class TextScroller
@@ -175,6 +273,33 @@ public:
 	}					bounds;
 	scroller_cb			cbEvents				= NULL;					// 
 
+	// what was last drawn into the foreground bitmap, a one pixel step from here can be drawn by shifting
+	struct
+	{
+		bool			visible;
+		int				position, top, textLen;
+		int				x0, x1;
+		const bitmap_font *font;
+	}					drawn					= { false, 0, 0, 0, 0, 0, NULL };
+
+	// drawable glyph at each edge of the bounds (0 = x0, 1 = x1), found again after a full redraw
+	struct
+	{
+		bool			valid;
+		int				textPosition;			// index in text, textLen if past the end
+		int				offset;					// offset of the glyph from scrollPosition
+	}					edgeGlyph[2]			= { { false, 0, 0 }, { false, 0, 0 } };
+
+	// optional pre-rendered 1-bpp strip of the text, one bit per column and font row, MSB first
+	// columns are used circularly so ring buffer text can be appended at the tail and consumed at the head
+	uint32_t			*strip					= NULL;
+	size_t				stripSize				= 0;					// in 32-bit words
+	int					stripStride				= 0;					// words per font row
+	int					stripChars				= 0;					// characters of text rendered into the strip
+	int					stripHead				= 0;					// column of the first character
+	int					stripTail				= 0;					// column after the last character
+	bool				stripValid				= false;
+
 	const bitmap_font	*scrollFont				= &apple5x7;
 	SmartMatrix			*matrix					= NULL;
 
@@ -203,6 +328,7 @@ public:
 	void setScrollBoundary(int x0, int y0, int x1, int y1)
 		{ bounds = {x0, y0, x1, y1}; }
 	void setRingBuffer(uint8_t *buffer, size_t size);
+	void setStripBuffer(uint32_t *buffer, size_t size);
 	size_t appendRing(const char *text);
 	bool getRingStatus(size_t &used, size_t &room);
 
@@ -215,6 +341,18 @@ public:
 
 	bool updateScrolling();
 	bool drawFramebuffer(size_t id);
+	bool getFramebufferRows(int &y0, int &y1) const;
+	bool canShiftFramebuffer(void) const;
+	bool isFramebufferCurrent(void) const;
+	void shiftFramebuffer(size_t id);
+
+private:
+	void resetStrip(void);
+	void updateStrip(void);
+	void trimStrip(int chars);
+	uint32_t getStripBits(int row, int offset) const;
+	int nextDrawableGlyph(int textPosition, int step);
+	int findEdgeGlyph(int edge, int offset);
 };
 
 
@@ -226,34 +364,44 @@ public:
 
     // drawing functions
     void swapBuffers(bool copy = true);
-    void drawPixel(int16_t x, int16_t y, const rgb24& color);
-    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const rgb24& color);
-    void drawFastVLine(int16_t x, int16_t y0, int16_t y1, const rgb24& color);
-    void drawFastHLine(int16_t x0, int16_t x1, int16_t y, const rgb24& color);
-    void drawCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb24& color);
-    void fillCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb24& outlineColor, const rgb24& fillColor);
-    void fillCircle(int16_t x0, int16_t y0, uint16_t radius, const rgb24& color);
-    void drawEllipse(int16_t x0, int16_t y0, uint16_t radiusX, uint16_t radiusY, const rgb24& color);
-    void drawTriangle(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3, const rgb24& color);
-    void fillTriangle(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3, const rgb24& fillColor);
+    void swapBuffersAt(uint32_t refreshFrame, bool copy = true);
+    void setSwapMode(swapModes mode);
+    void drawPixel(int16_t x, int16_t y, const bgcolor_t& color);
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const bgcolor_t& color);
+    void drawPolyline(const int16_t x[], const int16_t y[], uint8_t numPoints, const bgcolor_t& color);
+    void drawPolygon(const int16_t x[], const int16_t y[], uint8_t numPoints, const bgcolor_t& color);
+    void drawFastVLine(int16_t x, int16_t y0, int16_t y1, const bgcolor_t& color);
+    void drawFastHLine(int16_t x0, int16_t x1, int16_t y, const bgcolor_t& color);
+    void drawCircle(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& color);
+    void fillCircle(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& outlineColor, const bgcolor_t& fillColor);
+    void fillCircle(int16_t x0, int16_t y0, uint16_t radius, const bgcolor_t& color);
+    void drawEllipse(int16_t x0, int16_t y0, uint16_t radiusX, uint16_t radiusY, const bgcolor_t& color);
+    void drawTriangle(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3, const bgcolor_t& color);
+    void fillTriangle(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3, const bgcolor_t& fillColor);
     void fillTriangle(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3,
-      const rgb24& outlineColor, const rgb24& fillColor);
-    void drawRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const rgb24& color);
-    void fillRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const rgb24& color);
-    void fillRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const rgb24& outlineColor, const rgb24& fillColor);
-    void drawRoundRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t radius, const rgb24& outlineColor);
-    void fillRoundRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t radius, const rgb24& fillColor);
+      const bgcolor_t& outlineColor, const bgcolor_t& fillColor);
+    void fillPolygon(const int16_t x[], const int16_t y[], uint8_t numPoints, const bgcolor_t& fillColor);
+    void drawRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const bgcolor_t& color);
+    void fillRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const bgcolor_t& color);
+    void fillRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, const bgcolor_t& outlineColor, const bgcolor_t& fillColor);
+    void drawRoundRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t radius, const bgcolor_t& outlineColor);
+    void fillRoundRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t radius, const bgcolor_t& fillColor);
     void fillRoundRectangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t radius,
-      const rgb24& outlineColor, const rgb24& fillColor);
-    void fillScreen(const rgb24& color);
-    void drawChar(int16_t x, int16_t y, const rgb24& charColor, char character);
-    void drawString(int16_t x, int16_t y, const rgb24& charColor, const char text[]);
-    void drawString(int16_t x, int16_t y, const rgb24& charColor, const rgb24& backColor, const char text[]);
-    void drawMonoBitmap(int16_t x, int16_t y, uint8_t width, uint8_t height, const rgb24& bitmapColor, const uint8_t *bitmap);
-    const rgb24 readPixel(int16_t x, int16_t y) const;
-    rgb24 *backBuffer(void);
-    void setBackBuffer(rgb24 *newBuffer);
-    rgb24 *getRealBackBuffer(void);
+      const bgcolor_t& outlineColor, const bgcolor_t& fillColor);
+    void fillScreen(const bgcolor_t& color);
+    void drawChar(int16_t x, int16_t y, const bgcolor_t& charColor, char character);
+    void drawString(int16_t x, int16_t y, const bgcolor_t& charColor, const char text[]);
+    void drawString(int16_t x, int16_t y, const bgcolor_t& charColor, const bgcolor_t& backColor, const char text[]);
+    void drawMonoBitmap(int16_t x, int16_t y, uint8_t width, uint8_t height, const bgcolor_t& bitmapColor, const uint8_t *bitmap);
+    bgcolor_t readPixel(int16_t x, int16_t y) const;
+    bgcolor_t *backBuffer(void);
+    void setBackBuffer(bgcolor_t *newBuffer);
+    bgcolor_t *getRealBackBuffer(void);
+    bool getDirtyRect(int16_t &x0, int16_t &y0, int16_t &x1, int16_t &y1) const;
+
+    // background scrolling, applied by the refresh without redrawing, changes are shown from the next refresh frame
+    void setBackgroundScroll(int16_t x, int16_t y);
+    void setBackgroundImage(const bgcolor_t *image, uint16_t width, uint16_t height);
 
     // scroll text (backwards compatibility)
     void scrollText(const char inputtext[], int numScrolls)	{ scrollers[0].scrollText(inputtext, numScrolls); }
@@ -278,6 +426,19 @@ public:
     void drawForegroundMonoBitmap(int16_t x, int16_t y, uint8_t width, uint8_t height, uint8_t *bitmap, bool opaque = true);
     void displayForegroundDrawing(bool waitUntilComplete = true);
 
+    // tile layer, drawn over the background during refresh from 8x8 tiles, changes are shown from the next refresh frame
+    void setTileLayer(const bgcolor_t *tiles, const uint8_t *map, uint8_t mapWidth, uint8_t mapHeight);
+    void setTileMap(const uint8_t *map);
+    void setTileScroll(int16_t x, int16_t y);
+    void setTileTransparentColor(const bgcolor_t& color, bool transparent = true);
+
+    // sprites, drawn over the background and tile layer during refresh, changes are shown from the next refresh frame
+    void setSprite(uint8_t index, const bgcolor_t *bitmap, uint8_t width, uint8_t height, int16_t x, int16_t y);
+    void moveSprite(uint8_t index, int16_t x, int16_t y);
+    void setSpriteDepth(uint8_t index, uint8_t depth);
+    void setSpriteVisible(uint8_t index, bool visible);
+    void setSpriteTransparentColor(uint8_t index, const bgcolor_t& color, bool transparent = true);
+
     // configuration
     void setRotation(rotationDegrees rotation);
     uint16_t getScreenWidth(void) const;
@@ -287,6 +448,26 @@ public:
     void setColorCorrection(colorCorrectionModes mode);
     void setFont(fontChoices newFont);
 
+    // background palette, only used with BACKGROUND_INDEXED_COLOR, defaults to 3 bits red, 3 bits green and 2 bits blue
+    // changes are shown from the next refresh frame, and each call waits until the previous change is shown
+    void setPalette(const rgb24 colors[], uint8_t first = 0, uint16_t count = 256);
+    void setPaletteColor(uint8_t index, const rgb24& color);
+    const rgb24 getPaletteColor(uint8_t index) const;
+
+    // refresh underruns, the callback is called from the row calculation ISR
+    void getRefreshUnderruns(refresh_underruns *underruns);
+    void resetRefreshUnderruns(void);
+    void setRefreshEventCallback(refresh_cb func);
+
+    // refresh frames started so far, background frames given to swapBuffersAt() are shown from the requested
+    // frame number on, the vsync callback is called from the row calculation ISR when a new frame starts
+    uint32_t getRefreshFrameCount(void) const;
+    void setVsyncCallback(vsync_cb func);
+
+    // refresh statistics, only collected if REFRESH_STATS_ENABLED is set in the hardware header
+    void getRefreshStats(refresh_stats *stats);
+    void resetRefreshStats(void);
+
 private:
 	friend class TextScroller;
 
@@ -296,31 +477,44 @@ private:
 
     // functions called by ISR
     static void matrixCalculations(void);
+    static bool handleFrameUpdates(void);
 
     // functions for refreshing
-    static void loadMatrixBuffers(unsigned char currentRow);
+    static void loadMatrixBuffers(unsigned char currentRow, unsigned char freeRowBuffer);
 
     static color_chan_t colorCorrection(uint8_t inputcolor);
     static color_chan_t backgroundColorCorrection(uint8_t inputcolor);
 
     static void getPixel(uint8_t hardwareX, uint8_t hardwareY, rgb24 *xyPixel);
-    static rgb24 *getRefreshRow(uint8_t y);
-    static void handleBufferSwap(void);
+    static bgcolor_t *getRefreshRow(uint8_t hardwareY, int *columnStride);
+    static void getLocalRowPosition(uint8_t hardwareY, int *x, int *y, int *stepX, int *stepY);
+    static bool handleBackgroundScrollUpdate(void);
+    static const bgcolor_t *getScrolledRefreshRow(uint8_t hardwareY, bgcolor_t *row, int *columnStride);
+    static const rgb24 *getRefreshPalette(void);
+    static bool handleBufferSwap(uint32_t refreshFrame);
     void handleForegroundDrawingCopy(void);
-    void updateForeground(void);
-    bool getForegroundPixel(uint8_t x, uint8_t y, rgb24 *xyPixel);
+    bool updateForeground(void);
     void redrawForeground(void);
+    bool canShiftForeground(void);
+    static void updateForegroundMask(void);
+    static const uint32_t *getForegroundMaskRow(uint8_t hardwareY);
+    static const uint8_t *getForegroundColorIndexes(uint8_t hardwareY, int *columnStride);
+    static bool handleTileLayerUpdate(void);
+    static bool loadTileLayerRow(uint8_t hardwareY, bgcolor_t *row, const bgcolor_t *background, int backgroundStride);
+    static bool handleSpriteUpdate(void);
+    static bool spritesOnRow(uint8_t hardwareY);
+    static void loadSpriteRow(uint8_t hardwareY, bgcolor_t *row, const bgcolor_t *background, int backgroundStride);
 
     // drawing functions not meant for user
-	void drawHardwareHLine(uint16_t x0, uint16_t x1, uint16_t y, const rgb24& color);
-	void drawHardwareVLine(uint16_t x, uint16_t y0, uint16_t y1, const rgb24& color);
-    void bresteepline(int16_t x3, int16_t y3, int16_t x4, int16_t y4, const rgb24& color);
-    void fillFlatSideTriangleInt(int16_t x1, int16_t y1, int16_t x2, int16_t y2, int16_t x3, int16_t y3, const rgb24& color);
+    static void selectRotatedDrawing(void);
+    static void markAllDirty(void);
     static bool getBitmapPixelAtXY(uint8_t x, uint8_t y, uint8_t width, uint8_t height, const uint8_t *bitmap);
+    void drawGlyph(int16_t x, int16_t y, int location, const bgcolor_t& charColor, const bgcolor_t *backColor);
 
     // configuration helper functions
     static void calculateTimerLut(void);
     static void calculateBackgroundLUT(void);
+    static void calculateColorSpreadLUT(void);
 
     // configuration
     static colorCorrectionModes _ccmode;
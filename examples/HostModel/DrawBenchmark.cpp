@@ -0,0 +1,85 @@
+/*
+ * Host benchmark of the background drawing primitives
+ *
+ * Times each primitive into the drawing buffer with the refresh stopped, averaged over the four rotations,
+ * best of 11 runs. Coordinates are picked for MatrixHardware_KitV1_32x32.h, only drawing is timed.
+ *
+ * Build from the library directory, with the hardware header selected in SmartMatrix.h:
+ *   gcc -O2 -c Font_*.c
+ *   g++ -std=gnu++11 -O2 -DSMARTMATRIX_HOST -I. *.cpp Font_*.o examples/HostModel/DrawBenchmark.cpp -lpthread -o DrawBenchmark
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include "SmartMatrix_32x32.h"
+
+#define BENCHMARK_RUNS      11
+#define BENCHMARK_LOOPS     2000
+
+SmartMatrix matrix;
+
+static const rgb24 colorA = rgb24(0xff, 0x80, 0x00);
+static const rgb24 colorB = rgb24(0x00, 0x40, 0xff);
+
+static void benchmarkPixels(void) {
+    for (int i = 0; i < 512; i++)
+        matrix.drawPixel((i * 7) & 31, (i * 3) & 31, (i & 1) ? colorA : colorB);
+}
+
+static void benchmarkLines(void) {
+    for (int i = 0; i < 16; i++)
+        matrix.drawLine(i, 0, 31 - i, 31, (i & 1) ? colorA : colorB);
+}
+
+static void benchmarkCircles(void) {
+    for (int i = 0; i < 7; i++)
+        matrix.drawCircle(16, 16, 2 + (i * 2), (i & 1) ? colorA : colorB);
+}
+
+static void benchmarkRectangle(void) {
+    matrix.fillRectangle(0, 8, 31, 23, colorA);
+}
+
+static void benchmarkStrings(void) {
+    matrix.drawString(0, 4, colorA, "Smart");
+    matrix.drawString(0, 16, colorB, "Matrix");
+}
+
+// microseconds per call of func, averaged over the four rotations, best of BENCHMARK_RUNS
+static double timeDrawing(void (*func)(void)) {
+    static const rotationDegrees rotations[] = { rotation0, rotation90, rotation180, rotation270 };
+    double total = 0;
+
+    for (int r = 0; r < 4; r++) {
+        matrix.setRotation(rotations[r]);
+
+        double bestNs = 0;
+        for (int run = 0; run < BENCHMARK_RUNS; run++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int i = 0; i < BENCHMARK_LOOPS; i++)
+                func();
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            ns /= BENCHMARK_LOOPS;
+            if (!run || ns < bestNs)
+                bestNs = ns;
+        }
+        total += bestNs;
+    }
+
+    return total / 4 / 1000.0;
+}
+
+int main(void) {
+    matrix.begin();
+    matrix.setFont(font5x7);
+
+    printf("%dx%d background drawing, us per call:\n", MATRIX_WIDTH, MATRIX_HEIGHT);
+    printf("  512 drawPixel     %.2f\n", timeDrawing(benchmarkPixels));
+    printf("  16 drawLine       %.2f\n", timeDrawing(benchmarkLines));
+    printf("  7 drawCircle      %.2f\n", timeDrawing(benchmarkCircles));
+    printf("  fillRectangle     %.2f\n", timeDrawing(benchmarkRectangle));
+    printf("  2 drawString      %.2f\n", timeDrawing(benchmarkStrings));
+
+    return 0;
+}
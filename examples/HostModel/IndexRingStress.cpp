@@ -0,0 +1,63 @@
+/*
+ * Host stress test of IndexRing, the ring of DMA buffer indexes shared by the refresh ISRs
+ *
+ * A producer thread writes a sequence number into each slot it hands over, and a consumer thread checks
+ * that every slot arrives once and in order, standing in for rowCalculationISR and rowShiftCompleteISR.
+ * Neither side waits on the other except by polling isFull()/count() (yielding so it also runs on one core),
+ * so a lost, repeated or torn handoff shows up as a sequence error. A small capacity keeps both sides wrapping all the time.
+ *
+ * Build from the library directory (add -fsanitize=thread to also check for data races):
+ *   g++ -std=gnu++11 -O2 -DSMARTMATRIX_HOST -I. examples/HostModel/IndexRingStress.cpp -lpthread -o IndexRingStress
+ *   ./IndexRingStress [count]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include "IndexRing.h"
+
+#define STRESS_RING_CAPACITY    4
+#define STRESS_DEFAULT_COUNT    20000000
+
+static IndexRing<STRESS_RING_CAPACITY> ring;
+static uint32_t slots[STRESS_RING_CAPACITY];
+
+int main(int argc, char *argv[]) {
+    uint32_t total = (argc > 1) ? strtoul(argv[1], NULL, 0) : STRESS_DEFAULT_COUNT;
+    uint32_t errors = 0;
+    uint32_t overfull = 0;
+
+    std::thread producer([total]() {
+        for (uint32_t sequence = 0; sequence < total; sequence++) {
+            while (ring.isFull())
+                std::this_thread::yield();
+            slots[ring.nextWrite()] = sequence;
+            ring.write();
+        }
+    });
+
+    for (uint32_t expected = 0; expected < total; expected++) {
+        uint32_t count;
+
+        while ((count = ring.count()) == 0)
+            std::this_thread::yield();
+        if (count > STRESS_RING_CAPACITY)
+            overfull++;
+
+        uint32_t sequence = slots[ring.nextRead()];
+        ring.read();
+
+        if (sequence != expected) {
+            if (!errors)
+                printf("first error: expected %lu, read %lu\n", (unsigned long)expected, (unsigned long)sequence);
+            errors++;
+        }
+    }
+
+    producer.join();
+
+    printf("%lu indexes through a ring of %d: %lu sequence errors, %lu overfull counts\n",
+        (unsigned long)total, STRESS_RING_CAPACITY, (unsigned long)errors, (unsigned long)overfull);
+
+    return (errors || overfull || !ring.isEmpty()) ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * Host benchmark of the row calculation ISR, most of which is packing a row of pixels into GPIO words
+ *
+ * Calls the refresh ISRs the way the latch timer model in MatrixHost.h does, but without capturing the DMA
+ * stream, and reports the time per row with a random background, best of 11 runs. Compare the same hardware
+ * header before and after a change.
+ *
+ * Measured with MatrixHardware_KitV1_128x32.h, us per row:
+ *   before the SWAR bitplane transpose     4.6 - 6.3
+ *   SWAR bitplane transpose                2.6 - 3.3   (about 1.75x)
+ *   plus color spread tables               1.0 - 1.2   (about 4.5x)
+ *
+ * Build from the library directory, with the hardware header selected in SmartMatrix.h:
+ *   gcc -O2 -c Font_*.c
+ *   g++ -std=gnu++11 -O2 -DSMARTMATRIX_HOST -I. *.cpp Font_*.o examples/HostModel/PackBenchmark.cpp -lpthread -o PackBenchmark
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include "SmartMatrix_32x32.h"
+
+#define BENCHMARK_RUNS      11
+#define BENCHMARK_FRAMES    2000
+
+SmartMatrix matrix;
+
+// the refresh ISRs, defined in SmartMatrix.cpp
+void rowShiftCompleteISR(void);
+void rowCalculationISR(void);
+
+int main(void) {
+    uint32_t seed = 12345;
+    int x, y, run;
+    uint32_t row;
+
+    matrix.begin();
+
+    // random colors so every bitplane of every channel toggles
+    for (y = 0; y < MATRIX_HEIGHT; y++) {
+        for (x = 0; x < MATRIX_WIDTH; x++) {
+            seed = seed * 1664525 + 1013904223;
+            matrix.drawPixel(x, y, rgb24(seed >> 24, seed >> 16, seed >> 8));
+        }
+    }
+    matrix.swapBuffers(false);
+
+    // let the swap land and warm up the caches
+    matrixHostRunFrames(100);
+
+    double bestNs = 0;
+    for (run = 0; run < BENCHMARK_RUNS; run++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (row = 0; row < BENCHMARK_FRAMES * (MATRIX_HEIGHT / 2); row++) {
+            // rowShiftCompleteISR frees one row of the DMA buffer, rowCalculationISR packs the next one into it
+            rowShiftCompleteISR();
+            rowCalculationISR();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        ns /= (double)BENCHMARK_FRAMES * (MATRIX_HEIGHT / 2);
+        if (!run || ns < bestNs)
+            bestNs = ns;
+    }
+
+    printf("%dx%d, %d bit color: %.2f us per row\n", MATRIX_WIDTH, MATRIX_HEIGHT, COLOR_DEPTH_RGB, bestNs / 1000.0);
+
+#if REFRESH_STATS_ENABLED
+    refresh_stats stats;
+    matrix.getRefreshStats(&stats);
+    printf("loadMatrixBuffers: avg %.2f us, min %.2f us\n",
+        (stats.loadMatrixBuffers.avgCycles * 1000000.0) / stats.cyclesPerSecond,
+        (stats.loadMatrixBuffers.minCycles * 1000000.0) / stats.cyclesPerSecond);
+#endif
+
+    return 0;
+}